@@ -1,14 +1,42 @@
-QT += widgets
+QT += widgets concurrent
 requires(qtConfig(combobox))
 
 HEADERS       = renderarea.h \
-                line3d.h \
+                depthformat.h \
+                framebuffer.h \
+                frameprofiler.h \
+                golden.h \
+                headless.h \
+                hizbuffer.h \
+                mesh.h \
+                meshloader.h \
                 point3d.h \
+                renderer.h \
+                renderstats.h \
+                renderthread.h \
+                resolutiongovernor.h \
+                samplebuffer.h \
+                scene.h \
+                spankernel.h \
+                vertexstage.h \
                 window.h
 SOURCES       = main.cpp \
-                line3d.cpp \
+                depthformat.cpp \
+                framebuffer.cpp \
+                frameprofiler.cpp \
+                golden.cpp \
+                headless.cpp \
+                hizbuffer.cpp \
+                mesh.cpp \
+                meshloader.cpp \
                 point3d.cpp \
                 renderarea.cpp \
+                renderer.cpp \
+                renderthread.cpp \
+                resolutiongovernor.cpp \
+                samplebuffer.cpp \
+                spankernel.cpp \
+                vertexstage.cpp \
                 window.cpp
 RESOURCES     = basicdrawing.qrc
 
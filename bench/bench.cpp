@@ -0,0 +1,413 @@
+#include "benchmark.h"
+#include "mesh.h"
+#include "renderer.h"
+#include "scene.h"
+#include "spankernel.h"
+#include "vertexstage.h"
+
+#include <QtMath>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+// Fixed seed, so every run draws the same random scenes.
+const unsigned randomSeed = 12345;
+const float spanDepth = 1000;
+const QRgb spanColor = qRgb(0, 0, 255);
+const float spanColorCoeff = 0.8f;
+const FloatDepth spanFormat(0, spanDepth);
+
+static std::vector<std::vector<qint64>> resolutions()
+{
+    return {{640, 480}, {1280, 720}, {1920, 1080}};
+}
+
+// Scene that draws mesh coordinates as pixels; the globe stays in place.
+static Scene meshScene(std::shared_ptr<const Mesh> mesh)
+{
+    Scene scene;
+    scene.mesh = std::move(mesh);
+    scene.expansionCoeff = 1;
+    scene.offsetX = 0;
+    scene.offsetY = 0;
+    scene.offsetZ = 0;
+    return scene;
+}
+
+// count triangles with corners up to size pixels apart, spread over a
+// width x height screen at random depths.
+static std::shared_ptr<const Mesh> randomTriangles(int count, int size, int width, int height)
+{
+    std::mt19937 random(randomSeed);
+    std::uniform_real_distribution<float> x(0, width), y(0, height), z(0, spanDepth), offset(-size / 2.f, size / 2.f);
+    auto mesh = std::make_shared<Mesh>();
+    for (int i = 0; i < count; i++) {
+        const QVector3D center(x(random), y(random), z(random));
+        const quint32 first = static_cast<quint32>(mesh->positions.size());
+        for (int corner = 0; corner < 3; corner++) {
+            mesh->positions.push_back(center + QVector3D(offset(random), offset(random), offset(random)));
+        }
+        const quint32 face[] = {first, first + 1, first + 2};
+        mesh->addFace(face, 3);
+    }
+    return mesh;
+}
+
+// count star-shaped polygons of the given number of corners, alternately
+// near and far from their center, so every other corner is concave. Each
+// is planar, tilted at random, and up to size pixels across.
+static std::shared_ptr<const Mesh> randomPolygons(int count, int corners, int size, int width, int height)
+{
+    std::mt19937 random(randomSeed);
+    std::uniform_real_distribution<float> x(0, width), y(0, height), z(0, spanDepth), slope(-0.5f, 0.5f);
+    auto mesh = std::make_shared<Mesh>();
+    std::vector<quint32> face(corners);
+    for (int i = 0; i < count; i++) {
+        const QVector3D center(x(random), y(random), z(random));
+        const float slopeX = slope(random), slopeY = slope(random);
+        for (int corner = 0; corner < corners; corner++) {
+            const float angle = 2 * M_PI * corner / corners;
+            const float radius = (corner % 2 == 0 ? 0.5f : 0.25f) * size;
+            const float dx = radius * std::cos(angle), dy = radius * std::sin(angle);
+            face[corner] = static_cast<quint32>(mesh->positions.size());
+            mesh->positions.push_back(center + QVector3D(dx, dy, slopeX * dx + slopeY * dy));
+        }
+        mesh->addFace(face.data(), corners);
+    }
+    return mesh;
+}
+
+// count random segments up to length pixels long.
+static std::shared_ptr<const Mesh> randomLines(int count, int length, int width, int height)
+{
+    std::mt19937 random(randomSeed);
+    std::uniform_real_distribution<float> x(0, width), y(0, height), z(0, spanDepth), offset(-length / 2.f, length / 2.f);
+    auto mesh = std::make_shared<Mesh>();
+    for (int i = 0; i < count; i++) {
+        const QVector3D center(x(random), y(random), z(random));
+        const QVector3D half(offset(random), offset(random), offset(random));
+        const quint32 first = static_cast<quint32>(mesh->positions.size());
+        mesh->positions.push_back(center - half);
+        mesh->positions.push_back(center + half);
+        mesh->addEdge(first, first + 1);
+    }
+    return mesh;
+}
+
+// Unit UV sphere; the scene's expansion coefficient sets its radius.
+static std::shared_ptr<const Mesh> uvSphere(int rings, int segments)
+{
+    auto mesh = std::make_shared<Mesh>();
+    for (int ring = 0; ring <= rings; ring++) {
+        const float theta = M_PI * ring / rings;
+        for (int segment = 0; segment < segments; segment++) {
+            const float phi = 2 * M_PI * segment / segments;
+            mesh->positions.emplace_back(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+        }
+    }
+    for (int ring = 0; ring < rings; ring++) {
+        for (int segment = 0; segment < segments; segment++) {
+            const quint32 next = (segment + 1) % segments;
+            const quint32 quad[] = {static_cast<quint32>(ring * segments + segment), static_cast<quint32>(ring * segments + next),
+                                    static_cast<quint32>((ring + 1) * segments + next), static_cast<quint32>((ring + 1) * segments + segment)};
+            mesh->addFace(quad, 4);
+        }
+    }
+    return mesh;
+}
+
+// count spheres of radius up to maxRadius pixels at random positions and
+// depths; they replace the globe.
+static std::shared_ptr<const std::vector<Sphere>> randomSpheres(int count, float maxRadius, int width, int height)
+{
+    std::mt19937 random(randomSeed);
+    std::uniform_real_distribution<float> x(0, width), y(0, height), z(maxRadius, spanDepth), radius(0.5f, maxRadius);
+    auto spheres = std::make_shared<std::vector<Sphere>>();
+    for (int i = 0; i < count; i++) {
+        spheres->push_back({QVector3D(x(random), y(random), z(random)), radius(random)});
+    }
+    return spheres;
+}
+
+static void renderScene(bench::State& state, const Scene& scene, qint64 itemsPerFrame)
+{
+    Renderer renderer(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+    for (auto _ : state) {
+        renderer.render(scene);
+    }
+    state.setItemsProcessed(state.iterations() * itemsPerFrame);
+}
+
+// Micro benchmarks: the span kernel and the primitive paths of the
+// rasterizer, each on a fixed 1280x720 target.
+
+// A run that always passes the depth test; refilling the depth row is part
+// of the measurement.
+static void BM_ShadeSpanLinear(bench::State& state)
+{
+    const int count = static_cast<int>(state.range(0));
+    std::vector<QRgb> colors(count);
+    std::vector<float> depths(count);
+    for (auto _ : state) {
+        std::fill(depths.begin(), depths.end(), spanDepth);
+        shadeSpan(colors.data(), depths.data(), spanFormat, count, 0, 0.01f, spanColor, spanColorCoeff);
+    }
+    state.setItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_ShadeSpanLinear)->Args({8})->Args({64})->Args({1024});
+
+static void BM_ShadeSpanArray(bench::State& state)
+{
+    const int count = static_cast<int>(state.range(0));
+    std::vector<QRgb> colors(count);
+    std::vector<float> depths(count);
+    std::vector<float> z(count);
+    for (int i = 0; i < count; i++) {
+        z[i] = std::sqrt(static_cast<float>(i));
+    }
+    for (auto _ : state) {
+        std::fill(depths.begin(), depths.end(), spanDepth);
+        shadeSpan(colors.data(), depths.data(), spanFormat, count, z.data(), spanColor, spanColorCoeff);
+    }
+    state.setItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_ShadeSpanArray)->Args({8})->Args({64})->Args({1024});
+
+// A run that always fails the depth test.
+static void BM_ShadeSpanRejected(bench::State& state)
+{
+    const int count = static_cast<int>(state.range(0));
+    std::vector<QRgb> colors(count);
+    std::vector<float> depths(count, 0);
+    for (auto _ : state) {
+        shadeSpan(colors.data(), depths.data(), spanFormat, count, 1, 0.01f, spanColor, spanColorCoeff);
+    }
+    state.setItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_ShadeSpanRejected)->Args({64})->Args({1024});
+
+template<class Depth>
+static void shadeSpanIn(bench::State& state, const Depth& format)
+{
+    const int count = static_cast<int>(state.range(0));
+    std::vector<QRgb> colors(count);
+    std::vector<typename Depth::Value> depths(count);
+    for (auto _ : state) {
+        std::fill(depths.begin(), depths.end(), Depth::farthest());
+        shadeSpan(colors.data(), depths.data(), format, count, 0, 0.01f, spanColor, spanColorCoeff);
+    }
+    state.setItemsProcessed(state.iterations() * count);
+}
+
+// BM_ShadeSpanLinear in every depth format; the second argument is the
+// DepthFormat.
+static void BM_ShadeSpanDepthFormat(bench::State& state)
+{
+    switch (static_cast<DepthFormat>(state.range(1))) {
+    case DepthFormat::ReverseFloat32:
+        shadeSpanIn(state, ReverseFloatDepth(0, spanDepth));
+        break;
+    case DepthFormat::Unorm24:
+        shadeSpanIn(state, Unorm24Depth(0, spanDepth));
+        break;
+    case DepthFormat::Unorm16:
+        shadeSpanIn(state, Unorm16Depth(0, spanDepth));
+        break;
+    default:
+        shadeSpanIn(state, FloatDepth(0, spanDepth));
+        break;
+    }
+}
+BENCHMARK(BM_ShadeSpanDepthFormat)->Args({1024, 0})->Args({1024, 1})->Args({1024, 2})->Args({1024, 3});
+
+// One row through the middle of a sphere as wide as the span.
+static void BM_ShadeSphereSpan(bench::State& state)
+{
+    const int count = static_cast<int>(state.range(0));
+    const float radius = count / 2.f;
+    std::vector<QRgb> colors(count);
+    std::vector<float> depths(count);
+    for (auto _ : state) {
+        std::fill(depths.begin(), depths.end(), spanDepth);
+        shadeSphereSpan(colors.data(), depths.data(), spanFormat, count, -radius, radius * radius, spanDepth / 2, 1, spanColor, spanColorCoeff);
+    }
+    state.setItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_ShadeSphereSpan)->Args({8})->Args({64})->Args({1024});
+
+// Edge drawing, one depth test per pixel; arguments are the segment count,
+// length and width.
+static void BM_Lines(bench::State& state)
+{
+    const int count = static_cast<int>(state.range(2));
+    Scene scene = meshScene(randomLines(count, static_cast<int>(state.range(3)), 1280, 720));
+    scene.edgeWidth = static_cast<float>(state.range(4));
+    renderScene(state, scene, count);
+}
+BENCHMARK(BM_Lines)->Args({1280, 720, 1000, 16, 1})->Args({1280, 720, 1000, 256, 1})->Args({1280, 720, 1000, 256, 4});
+
+// Triangle setup and span fill; arguments are the triangle count and size.
+static void BM_Triangles(bench::State& state)
+{
+    const int count = static_cast<int>(state.range(2));
+    const Scene scene = meshScene(randomTriangles(count, static_cast<int>(state.range(3)), 1280, 720));
+    renderScene(state, scene, count);
+}
+BENCHMARK(BM_Triangles)->Args({1280, 720, 10000, 4})->Args({1280, 720, 1000, 64})->Args({1280, 720, 100, 512});
+
+// Scan conversion of concave polygons; arguments are the polygon count,
+// the corners of each and their size.
+static void BM_Polygons(bench::State& state)
+{
+    const int count = static_cast<int>(state.range(2));
+    const Scene scene = meshScene(randomPolygons(count, static_cast<int>(state.range(3)),
+                                                 static_cast<int>(state.range(4)), 1280, 720));
+    renderScene(state, scene, count);
+}
+BENCHMARK(BM_Polygons)->Args({1280, 720, 1000, 8, 64})->Args({1280, 720, 100, 64, 256});
+
+// The vertex stage alone: a rotation with perspective over count random
+// positions.
+static void BM_TransformVertices(bench::State& state)
+{
+    const int count = static_cast<int>(state.range(0));
+    std::mt19937 random(randomSeed);
+    std::uniform_real_distribution<float> coordinate(-1, 1);
+    std::vector<QVector3D> positions;
+    for (int i = 0; i < count; i++) {
+        positions.emplace_back(coordinate(random), coordinate(random), coordinate(random));
+    }
+    Scene scene;
+    scene.model.rotate(30, 1, 1, 0);
+    scene.projection = Scene::perspective(1000, 640, 360);
+    const QMatrix4x4 transform = scene.meshTransform();
+    ClipVertices clipVertices;
+    for (auto _ : state) {
+        transformVertices(transform, positions, clipVertices);
+    }
+    state.setItemsProcessed(state.iterations() * count);
+}
+BENCHMARK(BM_TransformVertices)->Args({1000})->Args({100000});
+
+// A tessellated sphere turned and seen in perspective, as while dragging
+// it around; arguments are the rings of the sphere, with twice as many
+// segments.
+static void BM_RotatedMesh(bench::State& state)
+{
+    const int rings = static_cast<int>(state.range(2));
+    Scene scene;
+    scene.mesh = uvSphere(rings, 2 * rings);
+    scene.expansionCoeff = 250;
+    scene.offsetX = 640;
+    scene.offsetY = 360;
+    scene.model.rotate(30, 1, 1, 0);
+    scene.projection = Scene::perspective(1000, 640, 360);
+    renderScene(state, scene, scene.mesh->faceCount());
+}
+BENCHMARK(BM_RotatedMesh)->Args({1280, 720, 32})->Args({1280, 720, 256});
+
+// Particles: many small spheres and no mesh; arguments are the sphere count
+// and the largest radius.
+static void BM_Spheres(bench::State& state)
+{
+    const int count = static_cast<int>(state.range(2));
+    Scene scene = meshScene(std::make_shared<const Mesh>());
+    scene.spheres = randomSpheres(count, static_cast<float>(state.range(3)), 1280, 720);
+    renderScene(state, scene, count);
+}
+BENCHMARK(BM_Spheres)->Args({1280, 720, 100000, 2})->Args({1280, 720, 100000, 8})->Args({1280, 720, 1000, 64});
+
+// Macro benchmarks: whole frames at several resolutions.
+
+static void BM_CubeGlobe(bench::State& state)
+{
+    renderScene(state, Scene(), 1);
+}
+
+static void BM_RandomTriangles(bench::State& state)
+{
+    const int width = static_cast<int>(state.range(0));
+    const int height = static_cast<int>(state.range(1));
+    const int count = static_cast<int>(state.range(2));
+    // Keeps the covered area, and so the overdraw, similar for every count.
+    const int size = std::max(static_cast<int>(std::sqrt(40. * width * height / count)), 2);
+    renderScene(state, meshScene(randomTriangles(count, size, width, height)), count);
+}
+
+// A tessellated sphere filling the middle of the screen; the third
+// argument is its radius in pixels.
+static void BM_Sphere(bench::State& state)
+{
+    Scene scene;
+    scene.mesh = uvSphere(32, 64);
+    scene.expansionCoeff = static_cast<int>(state.range(2));
+    scene.offsetX = static_cast<int>(state.range(0) / 2);
+    scene.offsetY = static_cast<int>(state.range(1) / 2);
+    renderScene(state, scene, 1);
+}
+
+// One analytic sphere in the middle of the screen instead of the globe; the
+// third argument is its radius in pixels.
+static void BM_AnalyticSphere(bench::State& state)
+{
+    Scene scene = meshScene(std::make_shared<const Mesh>());
+    const float radius = static_cast<float>(state.range(2));
+    scene.spheres = std::make_shared<const std::vector<Sphere>>(
+        1, Sphere{QVector3D(state.range(0) / 2, state.range(1) / 2, radius), radius});
+    renderScene(state, scene, 1);
+}
+
+// BM_RandomTriangles with 100000 triangles in the depth format given as
+// the third argument, for the fill rate each format gets.
+static void BM_DepthFormat(bench::State& state)
+{
+    const int width = static_cast<int>(state.range(0));
+    const int height = static_cast<int>(state.range(1));
+    const int count = 100000;
+    const int size = std::max(static_cast<int>(std::sqrt(40. * width * height / count)), 2);
+    Scene scene = meshScene(randomTriangles(count, size, width, height));
+    scene.depthFormat = static_cast<DepthFormat>(state.range(2));
+    renderScene(state, scene, count);
+}
+
+// The cube and the globe with the sample count given as the third
+// argument, for what antialiasing costs over a single sample.
+static void BM_Multisample(bench::State& state)
+{
+    Scene scene;
+    scene.samples = static_cast<int>(state.range(2));
+    renderScene(state, scene, 1);
+}
+
+static void registerMacroBenchmarks()
+{
+    bench::Benchmark* cubeGlobe = bench::registerBenchmark("BM_CubeGlobe", BM_CubeGlobe);
+    bench::Benchmark* triangles = bench::registerBenchmark("BM_RandomTriangles", BM_RandomTriangles);
+    bench::Benchmark* sphere = bench::registerBenchmark("BM_Sphere", BM_Sphere);
+    bench::Benchmark* analyticSphere = bench::registerBenchmark("BM_AnalyticSphere", BM_AnalyticSphere);
+    bench::Benchmark* depthFormat = bench::registerBenchmark("BM_DepthFormat", BM_DepthFormat);
+    bench::Benchmark* multisample = bench::registerBenchmark("BM_Multisample", BM_Multisample);
+    for (const auto& resolution : resolutions()) {
+        cubeGlobe->Args(resolution);
+        for (qint64 count : {1000, 100000}) {
+            triangles->Args({resolution[0], resolution[1], count});
+        }
+        for (qint64 radius : {100, 250, 500}) {
+            sphere->Args({resolution[0], resolution[1], radius});
+            analyticSphere->Args({resolution[0], resolution[1], radius});
+        }
+        for (qint64 format = 0; format <= static_cast<qint64>(DepthFormat::Unorm16); format++) {
+            depthFormat->Args({resolution[0], resolution[1], format});
+        }
+        for (qint64 samples : {1, 4, 8}) {
+            multisample->Args({resolution[0], resolution[1], samples});
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    registerMacroBenchmarks();
+    return bench::runBenchmarks(argc, argv);
+}
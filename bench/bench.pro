@@ -0,0 +1,33 @@
+# Rasterizer benchmarks. Build with `qmake bench.pro && make` in this
+# directory and run ./bench --help for the options.
+QT = core gui concurrent
+CONFIG += console release
+CONFIG -= app_bundle
+TEMPLATE = app
+TARGET = bench
+
+INCLUDEPATH += ..
+
+HEADERS       = benchmark.h \
+                ../depthformat.h \
+                ../framebuffer.h \
+                ../hizbuffer.h \
+                ../mesh.h \
+                ../point3d.h \
+                ../renderer.h \
+                ../renderstats.h \
+                ../samplebuffer.h \
+                ../scene.h \
+                ../spankernel.h \
+                ../vertexstage.h
+SOURCES       = bench.cpp \
+                benchmark.cpp \
+                ../depthformat.cpp \
+                ../framebuffer.cpp \
+                ../hizbuffer.cpp \
+                ../mesh.cpp \
+                ../point3d.cpp \
+                ../renderer.cpp \
+                ../samplebuffer.cpp \
+                ../spankernel.cpp \
+                ../vertexstage.cpp
@@ -0,0 +1,216 @@
+#include "benchmark.h"
+#include "spankernel.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QRegularExpression>
+#include <QTextStream>
+#include <QThread>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace bench {
+
+const double defaultMinTime = 0.5;
+const qint64 iterationLimit = 1000000000;
+
+State::State(qint64 iterations, const std::vector<qint64>& args)
+    : maxIterations(iterations)
+    , args(args)
+    , itemsProcessed(0)
+    , cpuStart(0)
+    , measuredNsecs(0)
+    , measuredCpuSeconds(0)
+{
+
+}
+
+void State::pauseTiming() {
+    measuredNsecs += realTimer.nsecsElapsed();
+    measuredCpuSeconds += static_cast<double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+}
+
+void State::resumeTiming() {
+    cpuStart = std::clock();
+    realTimer.start();
+}
+
+State::Iterator State::begin() {
+    resumeTiming();
+    return Iterator{this, maxIterations};
+}
+
+bool State::Iterator::operator!=(const Iterator&) const {
+    if (remaining > 0) {
+        return true;
+    }
+    state->pauseTiming();
+    return false;
+}
+
+Benchmark::Benchmark(const char* name, Function function)
+    : name(name)
+    , function(function)
+{
+
+}
+
+Benchmark* Benchmark::Args(const std::vector<qint64>& args) {
+    argSets.push_back(args);
+    return this;
+}
+
+static std::vector<Benchmark*>& benchmarks()
+{
+    static std::vector<Benchmark*> registered;
+    return registered;
+}
+
+Benchmark* registerBenchmark(const char* name, Function function) {
+    benchmarks().push_back(new Benchmark(name, function));
+    return benchmarks().back();
+}
+
+struct Result {
+    QString name;
+    qint64 iterations;
+    double realNsecs;
+    double cpuNsecs;
+    double itemsPerSecond;
+};
+
+// Grows the iteration count the way Google Benchmark does until one batch
+// runs for at least minTime seconds, then reports that batch.
+static Result run(const Benchmark& benchmark, const std::vector<qint64>& args, const QString& name, double minTime)
+{
+    qint64 iterations = 1;
+    for (;;) {
+        State state(iterations, args);
+        benchmark.run(state);
+        const double seconds = state.realNsecs() / 1e9;
+        if (seconds >= minTime || iterations >= iterationLimit) {
+            return {name, iterations, static_cast<double>(state.realNsecs()) / iterations, state.cpuSeconds() * 1e9 / iterations,
+                    state.items() > 0 && seconds > 0 ? state.items() / seconds : 0};
+        }
+        const double multiplier = seconds <= minTime / 10 ? 10 : minTime * 1.4 / seconds;
+        iterations = std::min(std::max(static_cast<qint64>(iterations * multiplier), iterations + 1), iterationLimit);
+    }
+}
+
+static QString runName(const QString& baseName, const std::vector<qint64>& args)
+{
+    QString name = baseName;
+    for (qint64 arg : args) {
+        name += QString("/%1").arg(arg);
+    }
+    return name;
+}
+
+static const char* optionValue(const char* argument, const char* option)
+{
+    const size_t length = std::strlen(option);
+    return std::strncmp(argument, option, length) == 0 && argument[length] == '=' ? argument + length + 1 : nullptr;
+}
+
+static void writeJson(QTextStream& out, const std::vector<Result>& results)
+{
+#ifdef QT_DEBUG
+    const char* buildType = "debug";
+#else
+    const char* buildType = "release";
+#endif
+    out << "{\n  \"context\": {\n"
+        << "    \"date\": \"" << QDateTime::currentDateTime().toString(Qt::ISODate) << "\",\n"
+        << "    \"num_cpus\": " << QThread::idealThreadCount() << ",\n"
+        << "    \"span_kernel\": \"" << spanKernelName() << "\",\n"
+        << "    \"library_build_type\": \"" << buildType << "\"\n"
+        << "  },\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& result = results[i];
+        out << (i == 0 ? "\n" : ",\n")
+            << "    {\n      \"name\": \"" << result.name << "\",\n"
+            << "      \"run_name\": \"" << result.name << "\",\n"
+            << "      \"run_type\": \"iteration\",\n"
+            << "      \"iterations\": " << result.iterations << ",\n"
+            << "      \"real_time\": " << result.realNsecs << ",\n"
+            << "      \"cpu_time\": " << result.cpuNsecs << ",\n"
+            << "      \"time_unit\": \"ns\"";
+        if (result.itemsPerSecond > 0) {
+            out << ",\n      \"items_per_second\": " << result.itemsPerSecond;
+        }
+        out << "\n    }";
+    }
+    out << "\n  ]\n}\n";
+}
+
+int runBenchmarks(int argc, char* argv[]) {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    QString filter = ".";
+    QString outFile;
+    bool jsonToStdout = false;
+    double minTime = defaultMinTime;
+    for (int i = 1; i < argc; i++) {
+        if (const char* value = optionValue(argv[i], "--benchmark_filter")) {
+            filter = value;
+        } else if (const char* value = optionValue(argv[i], "--benchmark_out")) {
+            outFile = value;
+        } else if (const char* value = optionValue(argv[i], "--benchmark_format")) {
+            jsonToStdout = std::strcmp(value, "json") == 0;
+        } else if (const char* value = optionValue(argv[i], "--benchmark_min_time")) {
+            minTime = std::atof(value);
+        } else {
+            err << "Unknown option " << argv[i] << "\n"
+                << "Options: --benchmark_filter=<regex> --benchmark_min_time=<seconds>"
+                << " --benchmark_format=<console|json> --benchmark_out=<file>\n";
+            return 1;
+        }
+    }
+    const QRegularExpression pattern(filter);
+    if (!pattern.isValid()) {
+        err << "Invalid filter " << filter << ": " << pattern.errorString() << "\n";
+        return 1;
+    }
+
+    std::vector<Result> results;
+    for (const Benchmark* benchmark : benchmarks()) {
+        std::vector<std::vector<qint64>> argSets = benchmark->arguments();
+        if (argSets.empty()) {
+            argSets.push_back({});
+        }
+        for (const auto& args : argSets) {
+            const QString name = runName(benchmark->benchmarkName(), args);
+            if (!pattern.match(name).hasMatch()) {
+                continue;
+            }
+            results.push_back(run(*benchmark, args, name, minTime));
+            if (!jsonToStdout) {
+                const Result& result = results.back();
+                out << result.name << "  " << qRound64(result.realNsecs) << " ns  " << qRound64(result.cpuNsecs) << " ns cpu  "
+                    << result.iterations << " iterations";
+                if (result.itemsPerSecond > 0) {
+                    out << "  " << result.itemsPerSecond / 1e6 << "M items/s";
+                }
+                out << "\n";
+                out.flush();
+            }
+        }
+    }
+
+    if (jsonToStdout) {
+        writeJson(out, results);
+    }
+    if (!outFile.isEmpty()) {
+        QFile file(outFile);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+            err << "Cannot write " << outFile << ": " << file.errorString() << "\n";
+            return 1;
+        }
+        QTextStream fileOut(&file);
+        writeJson(fileOut, results);
+    }
+    return 0;
+}
+
+}
@@ -0,0 +1,84 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QElapsedTimer>
+#include <QString>
+#include <ctime>
+#include <vector>
+
+// Minimal harness modelled on Google Benchmark: benchmarks are registered
+// with BENCHMARK(), loop with `for (auto _ : state)`, repeat until they run
+// for a minimum time and report in the same JSON layout, so the usual
+// comparison tooling can read the results.
+namespace bench {
+
+class State {
+public:
+    State(qint64 iterations, const std::vector<qint64>& args);
+
+    qint64 range(int index) const { return args[index]; }
+    qint64 iterations() const { return maxIterations; }
+    // Work done over all iterations, reported as items per second.
+    void setItemsProcessed(qint64 items) { itemsProcessed = items; }
+    // Leaves per-iteration setup out of the measurement.
+    void pauseTiming();
+    void resumeTiming();
+
+    // What `for (auto _ : state)` binds. Marked unused so the loop
+    // variable does not warn, as in Google Benchmark.
+    struct Q_DECL_UNUSED Value {};
+    struct Iterator {
+        State* state;
+        qint64 remaining;
+        bool operator!=(const Iterator& other) const;
+        Iterator& operator++() { remaining--; return *this; }
+        Value operator*() const { return Value(); }
+    };
+    Iterator begin();
+    Iterator end() { return Iterator{this, 0}; }
+
+    qint64 realNsecs() const { return measuredNsecs; }
+    double cpuSeconds() const { return measuredCpuSeconds; }
+    qint64 items() const { return itemsProcessed; }
+
+private:
+    qint64 maxIterations;
+    std::vector<qint64> args;
+    qint64 itemsProcessed;
+    QElapsedTimer realTimer;
+    std::clock_t cpuStart;
+    qint64 measuredNsecs;
+    double measuredCpuSeconds;
+};
+
+typedef void (*Function)(State&);
+
+class Benchmark {
+public:
+    Benchmark(const char* name, Function function);
+
+    // Adds one run with these arguments; a benchmark without any runs once
+    // with none.
+    Benchmark* Args(const std::vector<qint64>& args);
+
+    const QString& benchmarkName() const { return name; }
+    const std::vector<std::vector<qint64>>& arguments() const { return argSets; }
+    void run(State& state) const { function(state); }
+
+private:
+    QString name;
+    Function function;
+    std::vector<std::vector<qint64>> argSets;
+};
+
+Benchmark* registerBenchmark(const char* name, Function function);
+// Parses the --benchmark_* options, runs the matching benchmarks and
+// returns the process exit code.
+int runBenchmarks(int argc, char* argv[]);
+
+}
+
+#define BENCHMARK(function) \
+    static bench::Benchmark* const function##_benchmark = bench::registerBenchmark(#function, function)
+
+#endif // BENCHMARK_H
@@ -0,0 +1,26 @@
+#include "depthformat.h"
+
+namespace {
+
+const char* const formatNames[] = {"float32", "reverse-float32", "unorm24", "unorm16"};
+const int formatCount = sizeof(formatNames) / sizeof(formatNames[0]);
+
+}
+
+int depthFormatBytes(DepthFormat format) {
+    return format == DepthFormat::Unorm16 ? 2 : 4;
+}
+
+const char* depthFormatName(DepthFormat format) {
+    return formatNames[static_cast<int>(format)];
+}
+
+bool depthFormatFromName(const QString& name, DepthFormat& format) {
+    for (int i = 0; i < formatCount; i++) {
+        if (name == formatNames[i]) {
+            format = static_cast<DepthFormat>(i);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,101 @@
+#ifndef DEPTHFORMAT_H
+#define DEPTHFORMAT_H
+
+#include <QString>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+// How a depth plane stores the depth of a pixel. Float32 keeps scene z as
+// it is. The others first map z inside the scene's depth range to [0, 1],
+// clamping anything outside it:
+//   ReverseFloat32  1 - d as a float, so the near end sits at 1 and the far
+//                   end at 0, where floats are densest;
+//   Unorm24         d as a 24-bit integer in the low bits of 32-bit words;
+//   Unorm16         d as a 16-bit integer, half the bytes of the others.
+// Shading always uses the unmapped z; only the depth test sees the stored
+// value.
+enum class DepthFormat { Float32, ReverseFloat32, Unorm24, Unorm16 };
+
+int depthFormatBytes(DepthFormat format);
+const char* depthFormatName(DepthFormat format);
+bool depthFormatFromName(const QString& name, DepthFormat& format);
+
+// One struct per format with everything the depth test needs, so the
+// rasterizer can be instantiated once per format and the per-pixel code
+// has no branches on it.
+//
+// encode() maps scene z to a stored Value. key() turns a stored Value into
+// a float that grows with distance from the viewer in every format; a
+// fragment passes when its key is smaller than the stored one, and the
+// hierarchical depth buffer keeps block maxima of keys. fromKey() goes the
+// other way, to the nearest Value at least as far as key.
+//
+// Between nearestKey() and the key of farthest() the key is linear in z
+// before any rounding: linearKey(z) = z * keyScale() + linearKey(0).
+struct FloatDepth {
+    typedef float Value;
+    static const DepthFormat format = DepthFormat::Float32;
+
+    FloatDepth(float, float) {}
+    Value encode(float z) const { return z; }
+    static Value farthest() { return std::numeric_limits<float>::max(); }
+    static float key(Value value) { return value; }
+    static Value fromKey(float key) { return key; }
+    static float nearestKey() { return -std::numeric_limits<float>::max(); }
+    float keyScale() const { return 1; }
+    float linearKey(float z) const { return z; }
+};
+
+struct ReverseFloatDepth {
+    typedef float Value;
+    static const DepthFormat format = DepthFormat::ReverseFloat32;
+
+    ReverseFloatDepth(float nearZ, float farZ)
+        : scale(-1 / (farZ - nearZ))
+        , bias(farZ / (farZ - nearZ))
+    {
+
+    }
+    Value encode(float z) const { return std::min(std::max(z * scale + bias, 0.f), 1.f); }
+    static Value farthest() { return 0; }
+    static float key(Value value) { return -value; }
+    static Value fromKey(float key) { return -key; }
+    static float nearestKey() { return -1; }
+    float keyScale() const { return -scale; }
+    float linearKey(float z) const { return -(z * scale + bias); }
+
+    float scale, bias;
+};
+
+template<int Bits, class T>
+struct UnormDepth {
+    typedef T Value;
+    static const DepthFormat format = Bits == 16 ? DepthFormat::Unorm16 : DepthFormat::Unorm24;
+    static float maxValue() { return static_cast<float>((1 << Bits) - 1); }
+
+    UnormDepth(float nearZ, float farZ)
+        : scale(maxValue() / (farZ - nearZ))
+        , bias(-nearZ * maxValue() / (farZ - nearZ))
+    {
+
+    }
+    // Rounds to nearest even, as the vector conversion does.
+    Value encode(float z) const {
+        return static_cast<Value>(std::nearbyint(std::min(std::max(z * scale + bias, 0.f), maxValue())));
+    }
+    static Value farthest() { return static_cast<Value>(maxValue()); }
+    static float key(Value value) { return value; }
+    static Value fromKey(float key) { return static_cast<Value>(std::ceil(std::min(std::max(key, 0.f), maxValue()))); }
+    static float nearestKey() { return 0; }
+    float keyScale() const { return scale; }
+    float linearKey(float z) const { return z * scale + bias; }
+
+    float scale, bias;
+};
+
+typedef UnormDepth<24, uint32_t> Unorm24Depth;
+typedef UnormDepth<16, uint16_t> Unorm16Depth;
+
+#endif // DEPTHFORMAT_H
@@ -0,0 +1,197 @@
+#include "framebuffer.h"
+
+#include <QtGlobal>
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+const size_t planeAlignment = 64;
+
+namespace {
+
+size_t alignedPitch(size_t rowBytes) {
+    return (rowBytes + planeAlignment - 1) / planeAlignment * planeAlignment;
+}
+
+}
+
+template<class T>
+BufferPlane<T>::BufferPlane(int width, int height)
+    : planeWidth(width)
+    , planeHeight(height)
+    , rowPitch(alignedPitch(width * sizeof(T)))
+    , capacity(rowPitch * height)
+    , data(static_cast<uint8_t*>(qMallocAligned(capacity, planeAlignment)))
+{
+    if (data == nullptr) {
+        throw std::bad_alloc();
+    }
+}
+
+template<class T>
+BufferPlane<T>::~BufferPlane() {
+    qFreeAligned(data);
+}
+
+namespace {
+
+// True if value is one byte repeated, like white or 0, so it can be
+// written with memset.
+template<class T>
+bool isByteFill(T value, uint8_t& byte) {
+    uint8_t bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    byte = bytes[0];
+    return std::all_of(bytes, bytes + sizeof(T), [&] (uint8_t b) { return b == bytes[0]; });
+}
+
+}
+
+template<class T>
+void BufferPlane<T>::fill(T value) {
+    fill(QRect(0, 0, planeWidth, planeHeight), value);
+}
+
+template<class T>
+void BufferPlane<T>::fill(const QRect& rect, T value) {
+    if (rect.isEmpty()) {
+        return;
+    }
+    uint8_t byte;
+    if (!isByteFill(value, byte)) {
+        for (int y = rect.top(); y <= rect.bottom(); y++) {
+            std::fill_n(row(y) + rect.left(), rect.width(), value);
+        }
+    } else if (rect.left() == 0 && rect.width() == planeWidth) {
+        // Whole rows are one run of memory, padding included.
+        std::memset(row(rect.top()), byte, rect.height() * rowPitch);
+    } else {
+        for (int y = rect.top(); y <= rect.bottom(); y++) {
+            std::memset(row(y) + rect.left(), byte, rect.width() * sizeof(T));
+        }
+    }
+}
+
+template<class T>
+void BufferPlane<T>::resize(int width, int height) {
+    const size_t pitch = alignedPitch(width * sizeof(T));
+    if (pitch * height > capacity) {
+        uint8_t* grown = static_cast<uint8_t*>(qMallocAligned(pitch * height, planeAlignment));
+        if (grown == nullptr) {
+            throw std::bad_alloc();
+        }
+        qFreeAligned(data);
+        data = grown;
+        capacity = pitch * height;
+    }
+    planeWidth = width;
+    planeHeight = height;
+    rowPitch = pitch;
+}
+
+template class BufferPlane<QRgb>;
+template class BufferPlane<uint8_t>;
+
+namespace {
+
+template<class Depth>
+void fillDepth(BufferPlane<uint8_t>& plane, const QRect& rect) {
+    typedef typename Depth::Value Value;
+    const Value farthest = Depth::farthest();
+    const int bytes = static_cast<int>(sizeof(Value));
+    uint8_t byte;
+    if (isByteFill(farthest, byte)) {
+        plane.fill(QRect(rect.left() * bytes, rect.top(), rect.width() * bytes, rect.height()), byte);
+        return;
+    }
+    for (int y = rect.top(); y <= rect.bottom(); y++) {
+        std::fill_n(reinterpret_cast<Value*>(plane.row(y)) + rect.left(), rect.width(), farthest);
+    }
+}
+
+}
+
+DepthBuffer::DepthBuffer(int width, int height, DepthFormat format)
+    : planeWidth(width)
+    , depthFormat(format)
+    , plane(width * depthFormatBytes(format), height)
+{
+
+}
+
+void DepthBuffer::setFormat(DepthFormat format) {
+    depthFormat = format;
+    plane.resize(planeWidth * depthFormatBytes(format), plane.height());
+}
+
+void DepthBuffer::resize(int width, int height) {
+    planeWidth = width;
+    plane.resize(width * depthFormatBytes(depthFormat), height);
+}
+
+void DepthBuffer::clear(const QRect& rect) {
+    switch (depthFormat) {
+    case DepthFormat::Float32:
+        fillDepth<FloatDepth>(plane, rect);
+        break;
+    case DepthFormat::ReverseFloat32:
+        fillDepth<ReverseFloatDepth>(plane, rect);
+        break;
+    case DepthFormat::Unorm24:
+        fillDepth<Unorm24Depth>(plane, rect);
+        break;
+    case DepthFormat::Unorm16:
+        fillDepth<Unorm16Depth>(plane, rect);
+        break;
+    }
+}
+
+float DepthBuffer::valueAt(int x, int y) const {
+    switch (depthFormat) {
+    case DepthFormat::Unorm24:
+        return row<uint32_t>(y)[x];
+    case DepthFormat::Unorm16:
+        return row<uint16_t>(y)[x];
+    default:
+        return row<float>(y)[x];
+    }
+}
+
+float DepthBuffer::farthestValue() const {
+    switch (depthFormat) {
+    case DepthFormat::ReverseFloat32:
+        return ReverseFloatDepth::farthest();
+    case DepthFormat::Unorm24:
+        return Unorm24Depth::farthest();
+    case DepthFormat::Unorm16:
+        return Unorm16Depth::farthest();
+    default:
+        return FloatDepth::farthest();
+    }
+}
+
+FrameBuffer::FrameBuffer(int width, int height, DepthFormat depthFormat)
+    : colors(width, height)
+    , depths(width, height, depthFormat)
+    , objectIds(width, height)
+    , colorImage(colors.bits(), width, height, static_cast<int>(colors.pitch()), QImage::Format_RGB32)
+{
+
+}
+
+void FrameBuffer::resize(int width, int height) {
+    colors.resize(width, height);
+    depths.resize(width, height);
+    objectIds.resize(width, height);
+    colorImage = QImage(colors.bits(), width, height, static_cast<int>(colors.pitch()), QImage::Format_RGB32);
+}
+
+void FrameBuffer::clear(QRgb color) {
+    colors.fill(color);
+    depths.clear(QRect(0, 0, width(), height()));
+}
+
+void FrameBuffer::clear(const QRect& rect, QRgb color) {
+    colors.fill(rect, color);
+    depths.clear(rect);
+}
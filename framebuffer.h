@@ -0,0 +1,103 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <QImage>
+#include <QRect>
+#include <QRgb>
+#include <cstddef>
+#include <cstdint>
+#include "depthformat.h"
+
+// One plane of per-pixel values in a single aligned allocation. Rows are
+// padded to a multiple of planeAlignment bytes so every row starts on a
+// cache line and can be walked through the row pointer API.
+//
+// The allocation only ever grows: resizing to something that fits in
+// memory the plane already has keeps it, so a window dragged back and
+// forth reallocates at most until it reaches its largest size.
+template<class T>
+class BufferPlane {
+public:
+    BufferPlane(int width, int height);
+    ~BufferPlane();
+    BufferPlane(const BufferPlane&) = delete;
+    BufferPlane& operator=(const BufferPlane&) = delete;
+
+    int width() const { return planeWidth; }
+    int height() const { return planeHeight; }
+    size_t pitch() const { return rowPitch; }
+    uint8_t* bits() { return data; }
+    const uint8_t* bits() const { return data; }
+    T* row(int y) { return reinterpret_cast<T*>(data + y * rowPitch); }
+    const T* row(int y) const { return reinterpret_cast<const T*>(data + y * rowPitch); }
+    void fill(T value);
+    void fill(const QRect& rect, T value);
+    // Contents are undefined afterwards.
+    void resize(int width, int height);
+
+private:
+    int planeWidth, planeHeight;
+    size_t rowPitch;
+    size_t capacity;
+    uint8_t* data;
+};
+
+typedef BufferPlane<QRgb> ColorBuffer;
+typedef BufferPlane<uint8_t> ObjectIdBuffer;
+
+// Depth plane in one of the formats of depthformat.h. Rows are read and
+// written through row<T>() with the Value type of the current format.
+class DepthBuffer {
+public:
+    DepthBuffer(int width, int height, DepthFormat format);
+
+    int width() const { return planeWidth; }
+    int height() const { return plane.height(); }
+    DepthFormat format() const { return depthFormat; }
+    // Both leave the contents undefined until the plane is cleared.
+    void setFormat(DepthFormat format);
+    void resize(int width, int height);
+    template<class T>
+    T* row(int y) { return reinterpret_cast<T*>(plane.row(y)); }
+    template<class T>
+    const T* row(int y) const { return reinterpret_cast<const T*>(plane.row(y)); }
+    // Fills rect with the farthest value of the format.
+    void clear(const QRect& rect);
+    // Stored value of a pixel as a float: the depth for the float formats,
+    // the integer for the others.
+    float valueAt(int x, int y) const;
+    float farthestValue() const;
+
+private:
+    int planeWidth;
+    DepthFormat depthFormat;
+    BufferPlane<uint8_t> plane;
+};
+
+// Color, depth and object id planes of one render target. The color plane
+// is also exposed as a QImage that shares its memory, so a finished frame
+// can be drawn or saved without copying it. clear() fills the depth plane
+// with the farthest value of its format. Object ids are only written while
+// picking and are left alone by clear().
+class FrameBuffer {
+public:
+    FrameBuffer(int width, int height, DepthFormat depthFormat = DepthFormat::Float32);
+
+    int width() const { return colors.width(); }
+    int height() const { return colors.height(); }
+    const QImage& image() const { return colorImage; }
+    // Changes the size of every plane. Contents are undefined until the
+    // next clear.
+    void resize(int width, int height);
+    void clear(QRgb color);
+    void clear(const QRect& rect, QRgb color);
+
+    ColorBuffer colors;
+    DepthBuffer depths;
+    ObjectIdBuffer objectIds;
+
+private:
+    QImage colorImage;
+};
+
+#endif // FRAMEBUFFER_H
@@ -0,0 +1,87 @@
+#include "frameprofiler.h"
+
+#include <QFile>
+#include <QMutexLocker>
+#include <QTextStream>
+
+const int guiThreadId = 1;
+const int renderThreadId = 2;
+
+namespace {
+
+// Trace timestamps and durations are in microseconds.
+double micros(qint64 nsecs) {
+    return nsecs / 1e3;
+}
+
+// Starts a complete event; the caller appends the arguments, if any, and
+// closes it.
+void writeEvent(QTextStream& out, const char* name, int threadId, qint64 startNsecs, qint64 nsecs) {
+    out << ",\n{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << threadId
+        << ",\"ts\":" << micros(startNsecs) << ",\"dur\":" << micros(nsecs);
+}
+
+}
+
+FrameProfiler::FrameProfiler()
+{
+    clock.start();
+}
+
+void FrameProfiler::recordFrame(const RenderStats& stats) {
+    QMutexLocker locker(&mutex);
+    frames.push_back({clock.nsecsElapsed(), stats});
+}
+
+void FrameProfiler::recordPresent(qint64 nsecs) {
+    QMutexLocker locker(&mutex);
+    presents.push_back({clock.nsecsElapsed(), nsecs});
+}
+
+bool FrameProfiler::writeChromeTrace(const QString& fileName, QString& errorMessage) const {
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        errorMessage = file.errorString();
+        return false;
+    }
+    QMutexLocker locker(&mutex);
+    QTextStream out(&file);
+    // Nanosecond resolution in fixed notation; the default 6 significant
+    // digits would round every timestamp past one second.
+    out.setRealNumberNotation(QTextStream::FixedNotation);
+    out.setRealNumberPrecision(3);
+    out << "{\"traceEvents\":[";
+    out << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << guiThreadId << ",\"args\":{\"name\":\"gui\"}}";
+    out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << renderThreadId << ",\"args\":{\"name\":\"render\"}}";
+    for (const Frame& frame : frames) {
+        const RenderStats& stats = frame.stats;
+        const qint64 start = frame.endNsecs - stats.frameNsecs();
+        writeEvent(out, "frame", renderThreadId, start, stats.frameNsecs());
+        out << ",\"args\":{\"culledObjects\":" << stats.culledObjects << "}}";
+        writeEvent(out, "setup", renderThreadId, start, stats.setupNsecs);
+        out << "}";
+        // Tiles run in parallel, so the stages are reported as CPU time of
+        // the raster phase rather than as separate slices.
+        writeEvent(out, "raster", renderThreadId, start + stats.setupNsecs, stats.rasterNsecs);
+        out << ",\"args\":{";
+        for (int stage = 0; stage < RenderStats::StageCount; stage++) {
+            out << "\"" << RenderStats::stageName(stage) << "Us\":" << micros(stats.stageNsecs[stage]) << ",";
+        }
+        out << "\"fragmentsTested\":" << stats.fragmentsTested << ",\"fragmentsPassed\":" << stats.fragmentsPassed
+            << ",\"fragmentsCulled\":" << stats.fragmentsCulled << "}}";
+        out << ",\n{\"name\":\"fragments\",\"ph\":\"C\",\"pid\":1,\"tid\":" << renderThreadId << ",\"ts\":" << micros(start)
+            << ",\"args\":{\"passed\":" << stats.fragmentsPassed << ",\"rejected\":" << stats.fragmentsRejected()
+            << ",\"culled\":" << stats.fragmentsCulled << "}}";
+    }
+    for (const Present& present : presents) {
+        writeEvent(out, "present", guiThreadId, present.endNsecs - present.nsecs, present.nsecs);
+        out << "}";
+    }
+    out << "\n]}\n";
+    out.flush();
+    if (out.status() != QTextStream::Ok) {
+        errorMessage = file.errorString();
+        return false;
+    }
+    return true;
+}
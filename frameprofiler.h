@@ -0,0 +1,38 @@
+#ifndef FRAMEPROFILER_H
+#define FRAMEPROFILER_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+#include <vector>
+#include "renderstats.h"
+
+// Collects per-frame render statistics and presentation times from any
+// thread and writes them out in the Chrome trace event format, ready for
+// chrome://tracing or Perfetto.
+class FrameProfiler {
+public:
+    FrameProfiler();
+
+    // Both are stamped as having just finished.
+    void recordFrame(const RenderStats& stats);
+    void recordPresent(qint64 nsecs);
+    bool writeChromeTrace(const QString& fileName, QString& errorMessage) const;
+
+private:
+    struct Frame {
+        qint64 endNsecs;
+        RenderStats stats;
+    };
+    struct Present {
+        qint64 endNsecs;
+        qint64 nsecs;
+    };
+
+    mutable QMutex mutex;
+    QElapsedTimer clock;
+    std::vector<Frame> frames;
+    std::vector<Present> presents;
+};
+
+#endif // FRAMEPROFILER_H
@@ -0,0 +1,311 @@
+#include "golden.h"
+#include "renderer.h"
+
+#include <QDir>
+#include <QImage>
+#include <QTextStream>
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+const int goldenWidth = 640;
+const int goldenHeight = 480;
+const QRgb diffFailColor = qRgb(255, 0, 0);
+
+namespace {
+
+struct GoldenScene {
+    const char* name;
+    Scene scene;
+};
+
+// A tilted quad flanked by faces that are parallel to the view direction,
+// so they cover no area on screen and only their edges should show up.
+Mesh edgeOnMesh() {
+    Mesh mesh;
+    mesh.positions = {
+        QVector3D(-2, -2, -1), QVector3D(2, -2, 1), QVector3D(2, 2, 1), QVector3D(-2, 2, -1),
+        QVector3D(-3, -2, -2), QVector3D(-3, 2, -2), QVector3D(-3, 2, 2), QVector3D(-3, -2, 2),
+        QVector3D(-2, 3, -2), QVector3D(2, 3, -2), QVector3D(2, 3, 2), QVector3D(-2, 3, 2)
+    };
+    const quint32 faces[3][4] = {{0, 1, 2, 3}, {4, 5, 6, 7}, {8, 9, 10, 11}};
+    for (const auto& face : faces) {
+        mesh.addFace(face, 4);
+        for (int i = 0; i < 4; i++) {
+            mesh.addEdge(face[i], face[(i + 1) % 4]);
+        }
+    }
+    return mesh;
+}
+
+// Concave faces: a star and an L that reaches around into its notch,
+// tilted so depth varies across them, with their outlines as edges.
+Mesh concaveMesh() {
+    Mesh mesh;
+    const quint32 starCorners = 10;
+    std::vector<quint32> star;
+    for (quint32 i = 0; i < starCorners; i++) {
+        const float angle = 2 * static_cast<float>(M_PI) * i / starCorners;
+        const float radius = i % 2 == 0 ? 2 : 0.8f;
+        const float x = radius * std::cos(angle) - 1, y = radius * std::sin(angle);
+        star.push_back(static_cast<quint32>(mesh.positions.size()));
+        mesh.positions.push_back(QVector3D(x, y, 0.3f * x - 0.2f * y));
+    }
+    const float corners[][2] = {{1, -2}, {3, -2}, {3, 2}, {-0.5f, 2}, {-0.5f, 1.2f}, {1.8f, 1.2f}, {1.8f, -1.2f}, {1, -1.2f}};
+    std::vector<quint32> ell;
+    for (const auto& corner : corners) {
+        ell.push_back(static_cast<quint32>(mesh.positions.size()));
+        mesh.positions.push_back(QVector3D(corner[0], corner[1], -0.4f * corner[0] + 0.1f * corner[1] - 0.5f));
+    }
+    for (const std::vector<quint32>* face : {&star, &ell}) {
+        mesh.addFace(face->data(), static_cast<int>(face->size()));
+        for (size_t i = 0; i < face->size(); i++) {
+            mesh.addEdge((*face)[i], (*face)[(i + 1) % face->size()]);
+        }
+    }
+    return mesh;
+}
+
+// Edges that start and end at the same point, so they are drawn as dots,
+// next to one short edge for comparison.
+Mesh pointMesh() {
+    Mesh mesh;
+    for (int i = 0; i < 5; i++) {
+        const QVector3D point(i * 1.3f - 2.6f, 0.35f * i - 0.7f, 0.2f * i);
+        mesh.positions.push_back(point);
+        mesh.positions.push_back(point);
+        mesh.addEdge(2 * i, 2 * i + 1);
+    }
+    mesh.positions.push_back(QVector3D(-2.6f, 1.5f, 0));
+    mesh.positions.push_back(QVector3D(-2.4f, 1.6f, 0));
+    mesh.addEdge(10, 11);
+    return mesh;
+}
+
+// Overlapping spheres of fractional sizes and positions, some cut by the
+// frame border and some passing through each other.
+std::vector<Sphere> sphereField() {
+    std::vector<Sphere> spheres;
+    for (int row = 0; row < 6; row++) {
+        for (int column = 0; column < 8; column++) {
+            const QVector3D center(column * 90.5f - 20.25f, row * 95.25f - 10.5f, 150 + 37.5f * ((row + column) % 5));
+            spheres.push_back({center, 20.5f + 7.25f * ((row * 3 + column) % 7)});
+        }
+    }
+    spheres.push_back({QVector3D(320.5f, 240.5f, 100), 0.5f});
+    spheres.push_back({QVector3D(330, 250, 90), 1.75f});
+    return spheres;
+}
+
+std::vector<GoldenScene> goldenScenes() {
+    std::vector<GoldenScene> scenes;
+    const auto add = [&scenes] (const char* name, int offsetX, int offsetY, int offsetZ, int expansionCoeff) {
+        GoldenScene golden = {name, Scene()};
+        golden.scene.offsetX = offsetX;
+        golden.scene.offsetY = offsetY;
+        golden.scene.offsetZ = offsetZ;
+        golden.scene.expansionCoeff = expansionCoeff;
+        scenes.push_back(golden);
+        return &scenes.back().scene;
+    };
+    add("default", 200, 200, 200, 50);
+    add("small", 320, 240, 200, 5);
+    add("large", 320, 240, 200, 150);
+    add("negative_scale", 260, 220, 200, -40);
+    add("in_front_of_globe", 250, 230, -300, 50);
+    add("behind_globe", 250, 230, 700, 50);
+    add("through_globe", 230, 210, 180, 70);
+    add("clipped", 10, 470, 200, 80);
+    add("offscreen", -1000, 200, 200, 50);
+    const std::shared_ptr<const Mesh> edgeOn = std::make_shared<const Mesh>(edgeOnMesh());
+    add("edge_on", 400, 260, 200, 40)->mesh = edgeOn;
+    add("edge_on_globe", 220, 200, 200, 40)->mesh = edgeOn;
+    add("rotated", 320, 240, 200, 50)->model.rotate(35, 1, 2, 0);
+    Scene* perspective = add("perspective", 320, 240, 200, 60);
+    perspective->model.rotate(25, 1, 1, 0);
+    perspective->projection = Scene::perspective(400, goldenWidth / 2.f, goldenHeight / 2.f);
+    // The eye is inside the cube, so most of it is cut at the near plane.
+    Scene* nearClipped = add("near_clipped", 320, 240, -300, 100);
+    nearClipped->model.rotate(35, 1, 1, 0);
+    nearClipped->projection = Scene::perspective(400, goldenWidth / 2.f, goldenHeight / 2.f);
+    const std::shared_ptr<const std::vector<Sphere>> spheres = std::make_shared<const std::vector<Sphere>>(sphereField());
+    add("spheres", 320, 240, 250, 30)->spheres = spheres;
+    Scene* spheresOnly = add("spheres_only", 320, 240, 250, 30);
+    spheresOnly->spheres = spheres;
+    spheresOnly->mesh = std::make_shared<const Mesh>();
+    add("concave", 330, 240, 200, 60)->mesh = std::make_shared<const Mesh>(concaveMesh());
+    // Wide edges, in runs of pixels and multisampled as quads.
+    Scene* thickEdges = add("thick_edges", 320, 240, 200, 60);
+    thickEdges->model.rotate(35, 1, 2, 0);
+    thickEdges->edgeWidth = 3.5f;
+    Scene* thickEdgesMsaa = add("thick_edges_msaa4", 320, 240, 200, 60);
+    thickEdgesMsaa->model.rotate(35, 1, 2, 0);
+    thickEdgesMsaa->edgeWidth = 3.5f;
+    thickEdgesMsaa->samples = 4;
+    // The other depth formats, each where its precision matters most.
+    add("through_globe_unorm16", 230, 210, 180, 70)->depthFormat = DepthFormat::Unorm16;
+    Scene* spheresUnorm24 = add("spheres_unorm24", 320, 240, 250, 30);
+    spheresUnorm24->spheres = spheres;
+    spheresUnorm24->depthFormat = DepthFormat::Unorm24;
+    Scene* reverseZ = add("perspective_reverse_z", 320, 240, 200, 60);
+    reverseZ->model.rotate(25, 1, 1, 0);
+    reverseZ->projection = Scene::perspective(400, goldenWidth / 2.f, goldenHeight / 2.f);
+    reverseZ->depthFormat = DepthFormat::ReverseFloat32;
+    // Multisampled edges, intersections and sphere outlines.
+    add("through_globe_msaa4", 230, 210, 180, 70)->samples = 4;
+    Scene* perspectiveMsaa = add("perspective_msaa8", 320, 240, 200, 60);
+    perspectiveMsaa->model.rotate(25, 1, 1, 0);
+    perspectiveMsaa->projection = Scene::perspective(400, goldenWidth / 2.f, goldenHeight / 2.f);
+    perspectiveMsaa->samples = 8;
+    Scene* spheresMsaa = add("spheres_msaa4", 320, 240, 250, 30);
+    spheresMsaa->spheres = spheres;
+    spheresMsaa->samples = 4;
+    const std::shared_ptr<const Mesh> points = std::make_shared<const Mesh>(pointMesh());
+    const std::shared_ptr<const std::vector<Sphere>> noSpheres = std::make_shared<const std::vector<Sphere>>();
+    Scene* pointEdges = add("point_edges", 320, 240, 200, 60);
+    pointEdges->mesh = points;
+    pointEdges->spheres = noSpheres;
+    pointEdges->edgeWidth = 3;
+    Scene* pointEdgesMsaa = add("point_edges_msaa4", 320, 240, 200, 60);
+    pointEdgesMsaa->mesh = points;
+    pointEdgesMsaa->spheres = noSpheres;
+    pointEdgesMsaa->edgeWidth = 3;
+    pointEdgesMsaa->samples = 4;
+    return scenes;
+}
+
+QImage depthImage(const DepthBuffer& depths) {
+    QImage image(depths.width(), depths.height(), QImage::Format_ARGB32);
+    for (int y = 0; y < depths.height(); y++) {
+        // The raw float bits go into the pixel, so PNG keeps them exactly.
+        QRgb* pixels = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < depths.width(); x++) {
+            const float value = depths.valueAt(x, y);
+            std::memcpy(&pixels[x], &value, sizeof(value));
+        }
+    }
+    return image;
+}
+
+float depthAt(const QImage& image, int x, int y) {
+    const QRgb bits = reinterpret_cast<const QRgb*>(image.constScanLine(y))[x];
+    float depth;
+    std::memcpy(&depth, &bits, sizeof(depth));
+    return depth;
+}
+
+QRgb fadedPixel(QRgb pixel) {
+    const int gray = 192 + qGray(pixel) / 4;
+    return qRgb(gray, gray, gray);
+}
+
+bool colorsMatch(QRgb a, QRgb b, int tolerance) {
+    return std::abs(qRed(a) - qRed(b)) <= tolerance
+        && std::abs(qGreen(a) - qGreen(b)) <= tolerance
+        && std::abs(qBlue(a) - qBlue(b)) <= tolerance;
+}
+
+bool depthsMatch(float a, float b, float tolerance) {
+    return a == b || std::abs(a - b) <= tolerance * std::max({1.f, std::abs(a), std::abs(b)});
+}
+
+// Compares one scene against its references. Returns the number of
+// mismatching pixels, or -1 with errorMessage set when the references
+// cannot be read.
+int compareScene(const QString& name, const FrameBuffer& frame, const GoldenOptions& options,
+                 QImage& colorDiff, QImage& depthDiff, QString& errorMessage) {
+    const QDir dir(options.dir);
+    QImage referenceColor(dir.filePath(name + ".png"));
+    QImage referenceDepth(dir.filePath(name + "_depth.png"));
+    if (referenceColor.isNull() || referenceDepth.isNull()) {
+        errorMessage = "missing reference images";
+        return -1;
+    }
+    if (referenceColor.size() != frame.image().size() || referenceDepth.size() != frame.image().size()) {
+        errorMessage = "reference images have a different size";
+        return -1;
+    }
+    referenceColor = referenceColor.convertToFormat(QImage::Format_RGB32);
+    referenceDepth = referenceDepth.convertToFormat(QImage::Format_ARGB32);
+
+    const float farthest = frame.depths.farthestValue();
+    colorDiff = QImage(frame.width(), frame.height(), QImage::Format_RGB32);
+    depthDiff = QImage(frame.width(), frame.height(), QImage::Format_RGB32);
+    int mismatches = 0;
+    for (int y = 0; y < frame.height(); y++) {
+        const QRgb* colors = frame.colors.row(y);
+        const QRgb* expectedColors = reinterpret_cast<const QRgb*>(referenceColor.constScanLine(y));
+        QRgb* colorDiffRow = reinterpret_cast<QRgb*>(colorDiff.scanLine(y));
+        QRgb* depthDiffRow = reinterpret_cast<QRgb*>(depthDiff.scanLine(y));
+        for (int x = 0; x < frame.width(); x++) {
+            const bool colorOk = colorsMatch(colors[x], expectedColors[x], options.colorTolerance);
+            const float depth = frame.depths.valueAt(x, y);
+            const bool depthOk = depthsMatch(depth, depthAt(referenceDepth, x, y), options.depthTolerance);
+            colorDiffRow[x] = colorOk ? fadedPixel(expectedColors[x]) : diffFailColor;
+            depthDiffRow[x] = depthOk ? fadedPixel(depth != farthest ? qRgb(0, 0, 0) : qRgb(255, 255, 255))
+                                      : diffFailColor;
+            if (!colorOk || !depthOk) {
+                mismatches++;
+            }
+        }
+    }
+    return mismatches;
+}
+
+}
+
+int checkGoldenImages(const GoldenOptions& options) {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    if (options.update && !QDir().mkpath(options.dir)) {
+        err << "Cannot create reference directory " << options.dir << "\n";
+        return 1;
+    }
+    const QString diffDir = options.diffDir.isEmpty() ? options.dir : options.diffDir;
+
+    Renderer renderer(goldenWidth, goldenHeight);
+    int failures = 0;
+    for (const GoldenScene& golden : goldenScenes()) {
+        const QString name = golden.name;
+        renderer.render(golden.scene);
+        const FrameBuffer& frame = renderer.frame();
+
+        if (options.update) {
+            const QDir dir(options.dir);
+            if (!frame.image().save(dir.filePath(name + ".png"))
+                    || !depthImage(frame.depths).save(dir.filePath(name + "_depth.png"))) {
+                err << "Cannot write reference images of " << name << " to " << options.dir << "\n";
+                return 1;
+            }
+            out << name << ": updated\n";
+            continue;
+        }
+
+        QImage colorDiff, depthDiff;
+        QString errorMessage;
+        const int mismatches = compareScene(name, frame, options, colorDiff, depthDiff, errorMessage);
+        if (mismatches == 0) {
+            out << name << ": ok\n";
+            continue;
+        }
+        failures++;
+        if (mismatches < 0) {
+            out << name << ": " << errorMessage << "\n";
+            continue;
+        }
+        out << name << ": " << mismatches << " pixels differ\n";
+        if (!QDir().mkpath(diffDir)
+                || !colorDiff.save(QDir(diffDir).filePath(name + "_diff.png"))
+                || !depthDiff.save(QDir(diffDir).filePath(name + "_depth_diff.png"))) {
+            err << "Cannot write diff images of " << name << " to " << diffDir << "\n";
+        }
+    }
+    if (failures > 0) {
+        out << failures << " scenes differ from the references in " << options.dir << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,28 @@
+#ifndef GOLDEN_H
+#define GOLDEN_H
+
+#include <QString>
+
+struct GoldenOptions {
+    // Reference images are read from and written to this directory.
+    QString dir;
+    // Overwrites the references with the current output instead of
+    // comparing against them.
+    bool update;
+    // Diff images of failing scenes go here, or to dir when it is empty.
+    QString diffDir;
+    // Largest difference of a color channel that still counts as equal.
+    int colorTolerance;
+    // Largest relative difference of a depth value that still counts as
+    // equal.
+    float depthTolerance;
+};
+
+// Renders a fixed set of scenes and compares their color and depth planes
+// pixel by pixel against the references in options.dir. Every scene that
+// differs gets a color and a depth diff image. The references of the
+// current renderer are kept in golden/; see golden/README.
+// Returns the process exit code.
+int checkGoldenImages(const GoldenOptions& options);
+
+#endif // GOLDEN_H
@@ -0,0 +1,88 @@
+#include "headless.h"
+#include "frameprofiler.h"
+#include "renderer.h"
+#include "spankernel.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <algorithm>
+
+const int sweepMargin = 200;
+
+int renderHeadless(const Scene& initialScene, const HeadlessOptions& options) {
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    const int width = options.width;
+    const int height = options.height;
+    const int frames = options.frames;
+    const QString& outDir = options.outDir;
+    if (!outDir.isEmpty() && !QDir().mkpath(outDir)) {
+        err << "Cannot create output directory " << outDir << "\n";
+        return 1;
+    }
+
+    Renderer renderer(width, height);
+    renderer.setProfiling(options.profile || !options.traceFile.isEmpty());
+    FrameProfiler profiler;
+    RenderStats total;
+    Scene scene = initialScene;
+    const int sweepStart = sweepMargin;
+    const int sweepLength = std::max(width - 2 * sweepMargin, 0);
+
+    QElapsedTimer timer;
+    qint64 renderNsecs = 0;
+    int objects = 0;
+    for (int frame = 0; frame < frames; frame++) {
+        scene.offsetX = sweepStart + (frames > 1 ? sweepLength * frame / (frames - 1) : 0);
+
+        timer.start();
+        renderer.render(scene);
+        renderNsecs += timer.nsecsElapsed();
+        const RenderStats& stats = renderer.stats();
+        total.addTile(stats);
+        total.setupNsecs += stats.setupNsecs;
+        total.rasterNsecs += stats.rasterNsecs;
+        total.culledObjects += stats.culledObjects;
+        objects += renderer.objectCount();
+        if (!options.traceFile.isEmpty()) {
+            profiler.recordFrame(stats);
+        }
+
+        if (!outDir.isEmpty()) {
+            const QString fileName = QDir(outDir).filePath(QString("frame_%1.png").arg(frame, 5, 10, QChar('0')));
+            if (!renderer.frame().image().save(fileName)) {
+                err << "Cannot write " << fileName << "\n";
+                return 1;
+            }
+        }
+    }
+
+    const double renderMs = renderNsecs / 1e6;
+    out << "Rendered " << frames << " frames at " << width << "x" << height
+        << " in " << renderMs << " ms";
+    if (renderMs > 0) {
+        out << " (" << frames * 1000. / renderMs << " fps)";
+    }
+    out << ", " << total.culledObjects << " of " << objects << " objects culled\n";
+
+    if (options.profile && frames > 0) {
+        out << "Per frame, " << spanKernelName() << " span kernel, " << depthFormatName(scene.depthFormat) << " depth:\n";
+        out << "  setup  " << total.setupNsecs / 1e6 / frames << " ms\n";
+        out << "  raster " << total.rasterNsecs / 1e6 / frames << " ms\n";
+        for (int stage = 0; stage < RenderStats::StageCount; stage++) {
+            out << "    " << RenderStats::stageName(stage) << " " << total.stageNsecs[stage] / 1e6 / frames << " ms cpu\n";
+        }
+        out << "  fragments " << total.fragmentsTested / frames << " tested, " << total.fragmentsPassed / frames << " passed, "
+            << total.fragmentsRejected() / frames << " rejected, " << total.fragmentsCulled / frames << " culled by hi-z\n";
+        out << "  clears skipped in " << total.clearsSkipped / frames << " tiles\n";
+    }
+    if (!options.traceFile.isEmpty()) {
+        QString errorMessage;
+        if (!profiler.writeChromeTrace(options.traceFile, errorMessage)) {
+            err << "Cannot write " << options.traceFile << ": " << errorMessage << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,24 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <QString>
+#include "scene.h"
+
+struct HeadlessOptions {
+    int width;
+    int height;
+    int frames;
+    // Frames are written here as PNG files when it is not empty.
+    QString outDir;
+    // Prints where the render time went, per stage.
+    bool profile;
+    // Chrome trace of all frames is written here when it is not empty.
+    QString traceFile;
+};
+
+// Renders a sweep of the scene's mesh across the frame without opening a
+// window.
+// Returns the process exit code.
+int renderHeadless(const Scene& scene, const HeadlessOptions& options);
+
+#endif // HEADLESS_H
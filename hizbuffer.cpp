@@ -0,0 +1,109 @@
+#include "hizbuffer.h"
+
+#include <algorithm>
+
+namespace {
+
+template<class Depth>
+float farthestKey(const DepthBuffer& depths, int left, int top, int right, int bottom) {
+    typedef typename Depth::Value Value;
+    float farthest = Depth::key(depths.row<Value>(top)[left]);
+    for (int y = top; y < bottom; y++) {
+        const Value* depthRow = depths.row<Value>(y);
+        for (int x = left; x < right; x++) {
+            farthest = std::max(farthest, Depth::key(depthRow[x]));
+        }
+    }
+    return farthest;
+}
+
+}
+
+HiZBuffer::HiZBuffer(const DepthBuffer& depths)
+    : depths(depths)
+{
+    resize();
+}
+
+void HiZBuffer::resize() {
+    blockColumns = (depths.width() + blockSize - 1) / blockSize;
+    blockRows = (depths.height() + blockSize - 1) / blockSize;
+    maxDepths.assign(blockColumns * blockRows, 0);
+    dirty.assign(blockColumns * blockRows, 1);
+}
+
+void HiZBuffer::reset(const QRect& rect, float depth) {
+    for (int row = rect.top() >> blockShift; row <= rect.bottom() >> blockShift; row++) {
+        for (int column = rect.left() >> blockShift; column <= rect.right() >> blockShift; column++) {
+            const QRect block = QRect(column * blockSize, row * blockSize, blockSize, blockSize)
+                    .intersected(QRect(0, 0, depths.width(), depths.height()));
+            const int index = blockIndex(column, row);
+            if (rect.contains(block)) {
+                maxDepths[index] = depth;
+                dirty[index] = 0;
+            } else {
+                maxDepths[index] = std::max(maxDepths[index], depth);
+                dirty[index] = 1;
+            }
+        }
+    }
+}
+
+void HiZBuffer::markWritten(int y, int fromX, int toX) {
+    const int row = y >> blockShift;
+    for (int column = fromX >> blockShift; column <= toX >> blockShift; column++) {
+        dirty[blockIndex(column, row)] = 1;
+    }
+}
+
+float HiZBuffer::blockMax(int column, int row) {
+    const int index = blockIndex(column, row);
+    if (dirty[index]) {
+        const int left = column * blockSize;
+        const int top = row * blockSize;
+        const int right = std::min(left + blockSize, depths.width());
+        const int bottom = std::min(top + blockSize, depths.height());
+        float farthest;
+        switch (depths.format()) {
+        case DepthFormat::ReverseFloat32:
+            farthest = farthestKey<ReverseFloatDepth>(depths, left, top, right, bottom);
+            break;
+        case DepthFormat::Unorm24:
+            farthest = farthestKey<Unorm24Depth>(depths, left, top, right, bottom);
+            break;
+        case DepthFormat::Unorm16:
+            farthest = farthestKey<Unorm16Depth>(depths, left, top, right, bottom);
+            break;
+        default:
+            farthest = farthestKey<FloatDepth>(depths, left, top, right, bottom);
+            break;
+        }
+        maxDepths[index] = farthest;
+        dirty[index] = 0;
+    }
+    return maxDepths[index];
+}
+
+bool HiZBuffer::occludes(const QRect& rect, float nearestZ) {
+    if (rect.isEmpty()) {
+        return true;
+    }
+    for (int row = rect.top() >> blockShift; row <= rect.bottom() >> blockShift; row++) {
+        for (int column = rect.left() >> blockShift; column <= rect.right() >> blockShift; column++) {
+            if (!(nearestZ >= blockMax(column, row))) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool HiZBuffer::occludesSpan(int y, int fromX, int toX, float nearestZ) const {
+    const int row = y >> blockShift;
+    for (int column = fromX >> blockShift; column <= toX >> blockShift; column++) {
+        if (!(nearestZ >= maxDepths[blockIndex(column, row)])) {
+            return false;
+        }
+    }
+    return true;
+}
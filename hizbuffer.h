@@ -0,0 +1,53 @@
+#ifndef HIZBUFFER_H
+#define HIZBUFFER_H
+
+#include <QRect>
+#include <cstdint>
+#include <vector>
+#include "framebuffer.h"
+
+// Coarse depth level over a DepthBuffer: the farthest depth stored in every
+// blockSize x blockSize block, kept as a key of the depth format (see
+// depthformat.h) so larger always means farther. Depths passed in are keys
+// as well. Depth writes only ever bring pixels closer, so a block maximum
+// stays a valid upper bound until the block is cleared. Blocks that were
+// written are flagged and their maximum is tightened lazily, the next time
+// a query asks for it.
+//
+// A block belongs to exactly one render tile, so tiles rendered on
+// different threads never touch the same entries.
+class HiZBuffer {
+public:
+    static const int blockSize = 8;
+
+    explicit HiZBuffer(const DepthBuffer& depths);
+
+    // Follows a resize of the depth buffer. Every block is loose until it
+    // is reset.
+    void resize();
+    // Resets the blocks under a freshly cleared rectangle. Blocks the
+    // rectangle only partly covers are loosened to depth and tightened
+    // again on the next query.
+    void reset(const QRect& rect, float depth);
+    void markWritten(int x, int y) { dirty[blockIndex(x >> blockShift, y >> blockShift)] = 1; }
+    void markWritten(int y, int fromX, int toX);
+    // True if every stored depth in rect is at most nearestZ, so nothing
+    // at nearestZ or farther can pass the depth test there. Tightens the
+    // blocks it looks at first.
+    bool occludes(const QRect& rect, float nearestZ);
+    // Same test against the current block maxima without tightening them.
+    // Cheap enough to run for every span.
+    bool occludesSpan(int y, int fromX, int toX, float nearestZ) const;
+
+private:
+    static const int blockShift = 3;
+    int blockIndex(int column, int row) const { return row * blockColumns + column; }
+    float blockMax(int column, int row);
+
+    const DepthBuffer& depths;
+    int blockColumns, blockRows;
+    std::vector<float> maxDepths;
+    std::vector<uint8_t> dirty;
+};
+
+#endif // HIZBUFFER_H
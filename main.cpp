@@ -48,16 +48,204 @@
 **
 ****************************************************************************/
 
+#include "golden.h"
+#include "headless.h"
+#include "meshloader.h"
+#include "samplebuffer.h"
+#include "scene.h"
 #include "window.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+#include <cstring>
+
+const int headlessWidth = 1200;
+const int headlessHeight = 600;
+const float meshRadius = 3;
+const float goldenDepthTolerance = 1e-5f;
+const double maxRenderScale = 4;
+const float maxEdgeWidth = 64;
+
+static bool hasHeadlessFlag(int argc, char *argv[])
+{
+    const char *const flags[] = {"--headless", "--golden-check", "--golden-update"};
+    for (int i = 1; i < argc; i++) {
+        for (const char *flag : flags) {
+            if (std::strncmp(argv[i], flag, std::strlen(flag)) == 0
+                    && (argv[i][std::strlen(flag)] == '\0' || argv[i][std::strlen(flag)] == '=')) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static void setUpParser(QCommandLineParser &parser)
+{
+    parser.setApplicationDescription("Z-buffer renderer");
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption("headless", "Render without opening a window."));
+    parser.addOption(QCommandLineOption("frames", "Number of frames to render in headless mode.", "N", "100"));
+    parser.addOption(QCommandLineOption("out", "Directory to write headless frames, or golden check diffs, to as PNG files.", "dir"));
+    parser.addOption(QCommandLineOption("mesh", "OBJ or binary PLY file to render instead of the cube.", "file"));
+    parser.addOption(QCommandLineOption("perspective", "Eye distance in pixels for a perspective view; 0 keeps it orthographic.", "pixels", "0"));
+    parser.addOption(QCommandLineOption("depth-format", "Depth buffer format: float32, reverse-float32, unorm24 or unorm16.", "format", "float32"));
+    parser.addOption(QCommandLineOption("samples", "Samples per pixel: 1, or 4 or 8 for multisample antialiasing.", "N", "1"));
+    parser.addOption(QCommandLineOption("edge-width", "Width of mesh edges in pixels.", "pixels", "1"));
+    parser.addOption(QCommandLineOption("edge-bias", "Depth by which mesh edges are drawn nearer than they are, so faces do not hide them.", "depth", "1"));
+    parser.addOption(QCommandLineOption("render-scale", "Fraction of the screen resolution to render the window at, such as 0.5.", "factor", "1"));
+    parser.addOption(QCommandLineOption("frame-budget", "Render time in ms past which the window lowers its resolution while the scene moves; 0 keeps it fixed.", "ms", "16.6"));
+    parser.addOption(QCommandLineOption("fps-cap", "Frames per second to render at most; 0 follows the display.", "fps", "0"));
+    parser.addOption(QCommandLineOption("profile", "Time every render stage; shows the overlay or prints a summary in headless mode."));
+    parser.addOption(QCommandLineOption("trace", "Write a Chrome trace of all frames to this file on exit.", "file"));
+    parser.addOption(QCommandLineOption("golden-check", "Compare canonical scenes against the reference images in this directory.", "dir"));
+    parser.addOption(QCommandLineOption("golden-update", "Write the reference images of canonical scenes to this directory.", "dir"));
+    parser.addOption(QCommandLineOption("golden-tolerance", "Largest color channel difference the golden check accepts.", "N", "0"));
+}
+
+static bool loadScene(const QCommandLineParser &parser, Scene &scene, float &eyeDistance)
+{
+    bool ok;
+    eyeDistance = parser.value("perspective").toFloat(&ok);
+    if (!ok || eyeDistance < 0) {
+        QTextStream(stderr) << "Invalid eye distance: " << parser.value("perspective") << "\n";
+        return false;
+    }
+    if (!depthFormatFromName(parser.value("depth-format"), scene.depthFormat)) {
+        QTextStream(stderr) << "Invalid depth format: " << parser.value("depth-format") << "\n";
+        return false;
+    }
+    scene.samples = parser.value("samples").toInt(&ok);
+    if (!ok || (scene.samples != 1 && !samplePattern(scene.samples))) {
+        QTextStream(stderr) << "Invalid sample count: " << parser.value("samples") << "\n";
+        return false;
+    }
+    scene.edgeWidth = parser.value("edge-width").toFloat(&ok);
+    if (!ok || scene.edgeWidth <= 0 || scene.edgeWidth > maxEdgeWidth) {
+        QTextStream(stderr) << "Invalid edge width: " << parser.value("edge-width") << "\n";
+        return false;
+    }
+    scene.edgeDepthBias = parser.value("edge-bias").toFloat(&ok);
+    if (!ok) {
+        QTextStream(stderr) << "Invalid edge depth bias: " << parser.value("edge-bias") << "\n";
+        return false;
+    }
+    if (!parser.isSet("mesh")) {
+        return true;
+    }
+    Mesh mesh;
+    QString errorMessage;
+    if (!MeshLoader::load(parser.value("mesh"), mesh, errorMessage)) {
+        QTextStream(stderr) << "Cannot load " << parser.value("mesh") << ": " << errorMessage << "\n";
+        return false;
+    }
+    mesh.normalize(meshRadius);
+    scene.mesh = std::make_shared<const Mesh>(std::move(mesh));
+    return true;
+}
+
+static int runHeadless(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    setUpParser(parser);
+    parser.process(app);
+
+    bool ok;
+    if (parser.isSet("golden-check") || parser.isSet("golden-update")) {
+        GoldenOptions options;
+        options.update = parser.isSet("golden-update");
+        options.dir = parser.value(options.update ? "golden-update" : "golden-check");
+        options.diffDir = parser.value("out");
+        options.colorTolerance = parser.value("golden-tolerance").toInt(&ok);
+        options.depthTolerance = goldenDepthTolerance;
+        if (!ok || options.colorTolerance < 0) {
+            QTextStream(stderr) << "Invalid golden tolerance: " << parser.value("golden-tolerance") << "\n";
+            return 1;
+        }
+        return checkGoldenImages(options);
+    }
+    const int frames = parser.value("frames").toInt(&ok);
+    if (!ok || frames < 0) {
+        QTextStream(stderr) << "Invalid frame count: " << parser.value("frames") << "\n";
+        return 1;
+    }
+    Scene scene;
+    float eyeDistance;
+    if (!loadScene(parser, scene, eyeDistance)) {
+        return 1;
+    }
+    if (eyeDistance > 0) {
+        scene.projection = Scene::perspective(eyeDistance, headlessWidth / 2.f, headlessHeight / 2.f);
+    }
+    HeadlessOptions options;
+    options.width = headlessWidth;
+    options.height = headlessHeight;
+    options.frames = frames;
+    options.outDir = parser.value("out");
+    options.profile = parser.isSet("profile");
+    options.traceFile = parser.value("trace");
+    return renderHeadless(scene, options);
+}
 
 int main(int argc, char *argv[])
 {
     Q_INIT_RESOURCE(basicdrawing);
 
+    if (hasHeadlessFlag(argc, argv)) {
+        return runHeadless(argc, argv);
+    }
+
     QApplication app(argc, argv);
+    QCommandLineParser parser;
+    setUpParser(parser);
+    parser.process(app);
+    Scene scene;
+    float eyeDistance;
+    if (!loadScene(parser, scene, eyeDistance)) {
+        return 1;
+    }
+
+    bool ok;
+    const double frameRateCap = parser.value("fps-cap").toDouble(&ok);
+    if (!ok || frameRateCap < 0) {
+        QTextStream(stderr) << "Invalid frame rate cap: " << parser.value("fps-cap") << "\n";
+        return 1;
+    }
+    const double renderScale = parser.value("render-scale").toDouble(&ok);
+    if (!ok || renderScale <= 0 || renderScale > maxRenderScale) {
+        QTextStream(stderr) << "Invalid render scale: " << parser.value("render-scale") << "\n";
+        return 1;
+    }
+    const double frameBudget = parser.value("frame-budget").toDouble(&ok);
+    if (!ok || frameBudget < 0) {
+        QTextStream(stderr) << "Invalid frame budget: " << parser.value("frame-budget") << "\n";
+        return 1;
+    }
+
     Window window;
+    window.setMesh(scene.mesh);
+    window.setFrameRateCap(frameRateCap);
+    if (eyeDistance > 0) {
+        window.setPerspective(eyeDistance);
+    }
+    window.setDepthFormat(scene.depthFormat);
+    window.setSampleCount(scene.samples);
+    window.setEdgeStyle(scene.edgeWidth, scene.edgeDepthBias);
+    window.setRenderScale(renderScale);
+    window.setFrameTimeBudget(frameBudget);
+    window.setProfilerOverlayVisible(parser.isSet("profile"));
+    if (parser.isSet("trace")) {
+        window.startTracing();
+    }
     window.show();
-    return app.exec();
+    const int status = app.exec();
+
+    QString errorMessage;
+    if (parser.isSet("trace") && !window.saveTrace(parser.value("trace"), errorMessage)) {
+        QTextStream(stderr) << "Cannot write " << parser.value("trace") << ": " << errorMessage << "\n";
+        return 1;
+    }
+    return status;
 }
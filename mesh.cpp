@@ -0,0 +1,85 @@
+#include "mesh.h"
+
+#include <algorithm>
+#include <cmath>
+
+Mesh::Mesh()
+    : faceStarts(1, 0)
+{
+
+}
+
+void Mesh::addFace(const quint32* faceIndices, int count) {
+    indices.insert(indices.end(), faceIndices, faceIndices + count);
+    faceStarts.push_back(static_cast<quint32>(indices.size()));
+}
+
+void Mesh::addEdge(quint32 from, quint32 to) {
+    edges.push_back(from);
+    edges.push_back(to);
+}
+
+void Mesh::clear() {
+    positions.clear();
+    indices.clear();
+    faceStarts.assign(1, 0);
+    edges.clear();
+}
+
+bool Mesh::boundingBox(QVector3D& minimum, QVector3D& maximum) const {
+    if (positions.empty()) {
+        return false;
+    }
+    minimum = positions.front();
+    maximum = positions.front();
+    for (const QVector3D& position : positions) {
+        minimum = QVector3D(std::min(minimum.x(), position.x()), std::min(minimum.y(), position.y()), std::min(minimum.z(), position.z()));
+        maximum = QVector3D(std::max(maximum.x(), position.x()), std::max(maximum.y(), position.y()), std::max(maximum.z(), position.z()));
+    }
+    return true;
+}
+
+void Mesh::normalize(float radius) {
+    QVector3D minimum, maximum;
+    if (!boundingBox(minimum, maximum)) {
+        return;
+    }
+    const QVector3D center = (minimum + maximum) * 0.5f;
+    const float extent = (maximum - minimum).length() * 0.5f;
+    const float scale = extent > 0 ? radius / extent : 1;
+    for (QVector3D& position : positions) {
+        position = (position - center) * scale;
+    }
+}
+
+Mesh Mesh::cube() {
+    const float sqrt2 = std::sqrt(2.f);
+    const float sqrt6 = std::sqrt(6.f);
+    const quint32 cubeFaces[6][4] = {
+        {3, 2, 0, 5}, {2, 4, 6, 0}, {0, 6, 7, 5},
+        {3, 1, 7, 5}, {2, 4, 1, 3}, {1, 4, 6, 7}
+    };
+    const quint32 cubeEdges[12][2] = {
+        {0, 2}, {0, 5}, {0, 6}, {1, 3}, {1, 4}, {1, 7},
+        {2, 3}, {2, 4}, {3, 5}, {4, 6}, {5, 7}, {6, 7}
+    };
+
+    Mesh mesh;
+    mesh.positions = {
+        QVector3D(0, 0, -3),
+        QVector3D(0, 0, 3),
+        QVector3D(sqrt6, -sqrt2, -1),
+        QVector3D(0, -2 * sqrt2, 1),
+        QVector3D(sqrt6, sqrt2, 1),
+        QVector3D(-sqrt6, -sqrt2, -1),
+        QVector3D(0, 2 * sqrt2, -1),
+        QVector3D(-sqrt6, sqrt2, 1)
+    };
+    for (const auto& face : cubeFaces) {
+        mesh.addFace(face, 4);
+    }
+    for (const auto& edge : cubeEdges) {
+        mesh.addEdge(edge[0], edge[1]);
+    }
+    return mesh;
+}
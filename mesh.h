@@ -0,0 +1,35 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <QVector3D>
+#include <QtGlobal>
+#include <vector>
+
+// Indexed polygon mesh. positions is the vertex buffer and indices the
+// index buffer; face i uses indices[faceStarts[i]] up to but not including
+// indices[faceStarts[i + 1]]. edges holds pairs of vertex indices that are
+// drawn as lines on top of the faces.
+class Mesh {
+public:
+    Mesh();
+
+    int faceCount() const { return static_cast<int>(faceStarts.size()) - 1; }
+    int faceSize(int face) const { return faceStarts[face + 1] - faceStarts[face]; }
+    const quint32* faceIndices(int face) const { return indices.data() + faceStarts[face]; }
+    int edgeCount() const { return static_cast<int>(edges.size()) / 2; }
+    void addFace(const quint32* faceIndices, int count);
+    void addEdge(quint32 from, quint32 to);
+    void clear();
+    // Smallest axis-aligned box around positions; false if there are none.
+    bool boundingBox(QVector3D& minimum, QVector3D& maximum) const;
+    // Centers the mesh on the origin and scales it to the given radius.
+    void normalize(float radius);
+    static Mesh cube();
+
+    std::vector<QVector3D> positions;
+    std::vector<quint32> indices;
+    std::vector<quint32> faceStarts;
+    std::vector<quint32> edges;
+};
+
+#endif // MESH_H
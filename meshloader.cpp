@@ -0,0 +1,486 @@
+#include "meshloader.h"
+
+#include <QFile>
+#include <QtEndian>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+void skipBlanks(const char*& p, const char* end) {
+    while (p < end && isBlank(*p)) {
+        p++;
+    }
+}
+
+void skipLine(const char*& p, const char* end) {
+    const void* newline = std::memchr(p, '\n', end - p);
+    p = newline ? static_cast<const char*>(newline) + 1 : end;
+}
+
+bool parseInt(const char*& p, const char* end, long long& value) {
+    skipBlanks(p, end);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    if (p == end || !isDigit(*p)) {
+        return false;
+    }
+    value = 0;
+    while (p < end && isDigit(*p)) {
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+    if (negative) {
+        value = -value;
+    }
+    return true;
+}
+
+double powerOfTen(int exponent) {
+    static const double powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    if (exponent >= 0 && exponent <= 22) {
+        return powers[exponent];
+    }
+    if (exponent < 0 && exponent >= -22) {
+        return 1 / powers[-exponent];
+    }
+    return std::pow(10., exponent);
+}
+
+bool parseFloat(const char*& p, const char* end, float& value) {
+    skipBlanks(p, end);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    double mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    while (p < end && isDigit(*p)) {
+        mantissa = mantissa * 10 + (*p - '0');
+        digits++;
+        p++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && isDigit(*p)) {
+            mantissa = mantissa * 10 + (*p - '0');
+            exponent--;
+            digits++;
+            p++;
+        }
+    }
+    if (digits == 0) {
+        return false;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        long long exponentPart;
+        if (!parseInt(p, end, exponentPart)) {
+            return false;
+        }
+        exponent += static_cast<int>(exponentPart);
+    }
+    const double magnitude = mantissa * powerOfTen(exponent);
+    value = static_cast<float>(negative ? -magnitude : magnitude);
+    return true;
+}
+
+// Reads the vertex reference of an OBJ face or line element ("7", "7/1",
+// "7//3" or "7/1/3") and resolves it to a zero-based index.
+bool parseObjIndex(const char*& p, const char* end, size_t vertexCount, quint32& index) {
+    long long value;
+    if (!parseInt(p, end, value)) {
+        return false;
+    }
+    while (p < end && !isBlank(*p) && *p != '\n') {
+        p++;
+    }
+    const long long resolved = value < 0 ? static_cast<long long>(vertexCount) + value : value - 1;
+    if (value == 0 || resolved < 0 || resolved >= static_cast<long long>(vertexCount)) {
+        return false;
+    }
+    index = static_cast<quint32>(resolved);
+    return true;
+}
+
+bool atEndOfLine(const char*& p, const char* end) {
+    skipBlanks(p, end);
+    return p == end || *p == '\n' || *p == '#';
+}
+
+bool startsWithKeyword(const char* p, const char* end, const char* keyword) {
+    const size_t length = std::strlen(keyword);
+    return static_cast<size_t>(end - p) > length && std::memcmp(p, keyword, length) == 0 && isBlank(p[length]);
+}
+
+enum class PlyType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64, Invalid };
+
+PlyType plyType(const char* name, size_t length) {
+    static const struct { const char* name; PlyType type; } types[] = {
+        {"char", PlyType::Int8}, {"int8", PlyType::Int8},
+        {"uchar", PlyType::UInt8}, {"uint8", PlyType::UInt8},
+        {"short", PlyType::Int16}, {"int16", PlyType::Int16},
+        {"ushort", PlyType::UInt16}, {"uint16", PlyType::UInt16},
+        {"int", PlyType::Int32}, {"int32", PlyType::Int32},
+        {"uint", PlyType::UInt32}, {"uint32", PlyType::UInt32},
+        {"float", PlyType::Float32}, {"float32", PlyType::Float32},
+        {"double", PlyType::Float64}, {"float64", PlyType::Float64}
+    };
+    for (const auto& type : types) {
+        if (std::strlen(type.name) == length && std::memcmp(type.name, name, length) == 0) {
+            return type.type;
+        }
+    }
+    return PlyType::Invalid;
+}
+
+int plyTypeSize(PlyType type) {
+    switch (type) {
+    case PlyType::Int8:
+    case PlyType::UInt8:
+        return 1;
+    case PlyType::Int16:
+    case PlyType::UInt16:
+        return 2;
+    case PlyType::Int32:
+    case PlyType::UInt32:
+    case PlyType::Float32:
+        return 4;
+    case PlyType::Float64:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+template<class T>
+T readPlyRaw(const uchar* p, bool bigEndian) {
+    return bigEndian ? qFromBigEndian<T>(p) : qFromLittleEndian<T>(p);
+}
+
+double readPlyValue(const uchar* p, PlyType type, bool bigEndian) {
+    switch (type) {
+    case PlyType::Int8:
+        return static_cast<qint8>(*p);
+    case PlyType::UInt8:
+        return *p;
+    case PlyType::Int16:
+        return readPlyRaw<qint16>(p, bigEndian);
+    case PlyType::UInt16:
+        return readPlyRaw<quint16>(p, bigEndian);
+    case PlyType::Int32:
+        return readPlyRaw<qint32>(p, bigEndian);
+    case PlyType::UInt32:
+        return readPlyRaw<quint32>(p, bigEndian);
+    case PlyType::Float32: {
+        const quint32 bits = readPlyRaw<quint32>(p, bigEndian);
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    case PlyType::Float64: {
+        const quint64 bits = readPlyRaw<quint64>(p, bigEndian);
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    default:
+        return 0;
+    }
+}
+
+struct PlyProperty {
+    PlyType type;
+    PlyType countType;
+    bool isList;
+    int role;
+};
+
+enum PlyRole { OtherRole, XRole, YRole, ZRole, IndicesRole };
+
+const int maxPlyElements = 8;
+const int maxPlyProperties = 16;
+
+struct PlyElement {
+    enum Kind { Vertex, Face, Other };
+    Kind kind;
+    long long count;
+    int propertyCount;
+    PlyProperty properties[maxPlyProperties];
+};
+
+// Splits the next whitespace separated token of a header line.
+bool nextToken(const char*& p, const char* lineEnd, const char*& token, size_t& length) {
+    skipBlanks(p, lineEnd);
+    token = p;
+    while (p < lineEnd && !isBlank(*p)) {
+        p++;
+    }
+    length = p - token;
+    return length > 0;
+}
+
+bool tokenIs(const char* token, size_t length, const char* text) {
+    return std::strlen(text) == length && std::memcmp(token, text, length) == 0;
+}
+
+}
+
+bool MeshLoader::load(const QString& fileName, Mesh& mesh, QString& errorMessage) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        errorMessage = file.errorString();
+        return false;
+    }
+    const qint64 size = file.size();
+    if (size == 0) {
+        errorMessage = "File is empty";
+        return false;
+    }
+    uchar* data = file.map(0, size);
+    if (data == nullptr) {
+        errorMessage = file.errorString();
+        return false;
+    }
+    const char* begin = reinterpret_cast<const char*>(data);
+    const char* end = begin + size;
+
+    mesh.clear();
+    const bool isPly = size >= 4 && std::memcmp(begin, "ply", 3) == 0 && (begin[3] == '\n' || begin[3] == '\r');
+    const bool loaded = isPly ? loadPly(begin, end, mesh, errorMessage) : loadObj(begin, end, mesh, errorMessage);
+    file.unmap(data);
+    if (!loaded) {
+        mesh.clear();
+    }
+    return loaded;
+}
+
+bool MeshLoader::loadObj(const char* begin, const char* end, Mesh& mesh, QString& errorMessage) {
+    std::vector<quint32> face;
+    int line = 1;
+    for (const char* p = begin; p < end; line++) {
+        skipBlanks(p, end);
+        if (startsWithKeyword(p, end, "v")) {
+            p += 1;
+            float x, y, z;
+            if (!parseFloat(p, end, x) || !parseFloat(p, end, y) || !parseFloat(p, end, z)) {
+                errorMessage = QString("Invalid vertex on line %1").arg(line);
+                return false;
+            }
+            mesh.positions.emplace_back(x, y, z);
+        } else if (startsWithKeyword(p, end, "f") || startsWithKeyword(p, end, "l")) {
+            const bool isFace = *p == 'f';
+            p += 1;
+            face.clear();
+            while (!atEndOfLine(p, end)) {
+                quint32 index;
+                if (!parseObjIndex(p, end, mesh.positions.size(), index)) {
+                    errorMessage = QString("Invalid vertex index on line %1").arg(line);
+                    return false;
+                }
+                face.push_back(index);
+            }
+            if (isFace && face.size() >= 3) {
+                mesh.addFace(face.data(), static_cast<int>(face.size()));
+            } else {
+                for (size_t i = 1; i < face.size(); i++) {
+                    mesh.addEdge(face[i - 1], face[i]);
+                }
+            }
+        }
+        skipLine(p, end);
+    }
+    if (mesh.positions.empty()) {
+        errorMessage = "No vertices found";
+        return false;
+    }
+    return true;
+}
+
+bool MeshLoader::loadPly(const char* begin, const char* end, Mesh& mesh, QString& errorMessage) {
+    PlyElement elements[maxPlyElements];
+    int elementCount = 0;
+    bool bigEndian = false;
+    bool hasFormat = false;
+
+    const char* p = begin;
+    skipLine(p, end);
+    for (;;) {
+        if (p >= end) {
+            errorMessage = "PLY header has no end_header";
+            return false;
+        }
+        const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (lineEnd == nullptr) {
+            lineEnd = end;
+        }
+        const char* token;
+        size_t length;
+        if (!nextToken(p, lineEnd, token, length)) {
+            p = lineEnd + 1;
+            continue;
+        }
+        if (tokenIs(token, length, "end_header")) {
+            p = lineEnd + 1;
+            break;
+        }
+        if (tokenIs(token, length, "format")) {
+            nextToken(p, lineEnd, token, length);
+            if (tokenIs(token, length, "binary_little_endian")) {
+                bigEndian = false;
+            } else if (tokenIs(token, length, "binary_big_endian")) {
+                bigEndian = true;
+            } else {
+                errorMessage = "Only binary PLY files are supported";
+                return false;
+            }
+            hasFormat = true;
+        } else if (tokenIs(token, length, "element")) {
+            if (elementCount == maxPlyElements) {
+                errorMessage = "Too many PLY elements";
+                return false;
+            }
+            PlyElement& element = elements[elementCount++];
+            nextToken(p, lineEnd, token, length);
+            element.kind = tokenIs(token, length, "vertex") ? PlyElement::Vertex
+                         : tokenIs(token, length, "face") ? PlyElement::Face
+                         : PlyElement::Other;
+            element.propertyCount = 0;
+            if (!parseInt(p, lineEnd, element.count) || element.count < 0) {
+                errorMessage = "Invalid PLY element count";
+                return false;
+            }
+        } else if (tokenIs(token, length, "property")) {
+            if (elementCount == 0 || elements[elementCount - 1].propertyCount == maxPlyProperties) {
+                errorMessage = "Unexpected PLY property";
+                return false;
+            }
+            PlyElement& element = elements[elementCount - 1];
+            PlyProperty& property = element.properties[element.propertyCount++];
+            nextToken(p, lineEnd, token, length);
+            property.isList = tokenIs(token, length, "list");
+            property.countType = PlyType::Invalid;
+            if (property.isList) {
+                nextToken(p, lineEnd, token, length);
+                property.countType = plyType(token, length);
+                nextToken(p, lineEnd, token, length);
+            }
+            property.type = plyType(token, length);
+            if (property.type == PlyType::Invalid || (property.isList && property.countType == PlyType::Invalid)) {
+                errorMessage = "Unknown PLY property type";
+                return false;
+            }
+            nextToken(p, lineEnd, token, length);
+            property.role = OtherRole;
+            if (element.kind == PlyElement::Vertex && !property.isList) {
+                property.role = tokenIs(token, length, "x") ? XRole
+                              : tokenIs(token, length, "y") ? YRole
+                              : tokenIs(token, length, "z") ? ZRole
+                              : OtherRole;
+            } else if (element.kind == PlyElement::Face && property.isList
+                       && (tokenIs(token, length, "vertex_indices") || tokenIs(token, length, "vertex_index"))) {
+                property.role = IndicesRole;
+            }
+        }
+        p = lineEnd + 1;
+    }
+    if (!hasFormat) {
+        errorMessage = "PLY header has no format";
+        return false;
+    }
+
+    const uchar* data = reinterpret_cast<const uchar*>(p);
+    const uchar* dataEnd = reinterpret_cast<const uchar*>(end);
+    std::vector<quint32> face;
+    for (int e = 0; e < elementCount; e++) {
+        const PlyElement& element = elements[e];
+        if (element.kind == PlyElement::Vertex) {
+            // Every vertex takes at least this many bytes, so a count the
+            // rest of the file cannot hold is refused before reserving.
+            int recordSize = 0;
+            for (int i = 0; i < element.propertyCount; i++) {
+                const PlyProperty& property = element.properties[i];
+                recordSize += plyTypeSize(property.isList ? property.countType : property.type);
+            }
+            if (recordSize == 0 && element.count > 0) {
+                errorMessage = "PLY vertices have no properties";
+                return false;
+            }
+            if (recordSize > 0 && (dataEnd - data) / recordSize < element.count) {
+                errorMessage = "PLY file is truncated";
+                return false;
+            }
+            mesh.positions.reserve(element.count);
+        }
+        for (long long item = 0; item < element.count; item++) {
+            float position[3] = {0, 0, 0};
+            face.clear();
+            for (int i = 0; i < element.propertyCount; i++) {
+                const PlyProperty& property = element.properties[i];
+                if (!property.isList) {
+                    const int size = plyTypeSize(property.type);
+                    if (dataEnd - data < size) {
+                        errorMessage = "PLY file is truncated";
+                        return false;
+                    }
+                    if (property.role >= XRole && property.role <= ZRole) {
+                        position[property.role - XRole] = static_cast<float>(readPlyValue(data, property.type, bigEndian));
+                    }
+                    data += size;
+                    continue;
+                }
+                const int countSize = plyTypeSize(property.countType);
+                if (dataEnd - data < countSize) {
+                    errorMessage = "PLY file is truncated";
+                    return false;
+                }
+                const long long count = static_cast<long long>(readPlyValue(data, property.countType, bigEndian));
+                data += countSize;
+                const int size = plyTypeSize(property.type);
+                if (count < 0 || (dataEnd - data) / size < count) {
+                    errorMessage = "PLY file is truncated";
+                    return false;
+                }
+                if (property.role == IndicesRole) {
+                    for (long long j = 0; j < count; j++) {
+                        // Checked as read, since negative or huge values do
+                        // not convert to an index.
+                        const double index = readPlyValue(data + j * size, property.type, bigEndian);
+                        if (!(index >= 0 && index < mesh.positions.size())) {
+                            errorMessage = "PLY face references a missing vertex";
+                            return false;
+                        }
+                        face.push_back(static_cast<quint32>(index));
+                    }
+                }
+                data += count * size;
+            }
+            if (element.kind == PlyElement::Vertex) {
+                mesh.positions.emplace_back(position[0], position[1], position[2]);
+            } else if (element.kind == PlyElement::Face && face.size() >= 3) {
+                mesh.addFace(face.data(), static_cast<int>(face.size()));
+            }
+        }
+    }
+    if (mesh.positions.empty()) {
+        errorMessage = "No vertices found";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,19 @@
+#ifndef MESHLOADER_H
+#define MESHLOADER_H
+
+#include <QString>
+#include "mesh.h"
+
+// Reads Wavefront OBJ and binary PLY files into a Mesh. The file is
+// memory-mapped and parsed in place without allocating per line or per
+// element, so loading cost is dominated by the mesh buffers themselves.
+class MeshLoader {
+public:
+    static bool load(const QString& fileName, Mesh& mesh, QString& errorMessage);
+
+private:
+    static bool loadObj(const char* begin, const char* end, Mesh& mesh, QString& errorMessage);
+    static bool loadPly(const char* begin, const char* end, Mesh& mesh, QString& errorMessage);
+};
+
+#endif // MESHLOADER_H
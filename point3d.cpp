@@ -1,3 +1,3 @@
 #include "point3d.h"
 
-Point3D::Point3D(int x, int y, double z): x(x), y(y), z(z) {};
+Point3D::Point3D(float x, float y, double z): x(x), y(y), z(z) {};
@@ -2,11 +2,13 @@
 #define POINT3D_H
 
 
+// Vertex on screen: x and y in pixels with a fractional part, z the depth
+// tested against the depth buffer.
 class Point3D
 {
 public:
-    Point3D(int x, int y, double z);
-    int x, y;
+    Point3D(float x, float y, double z);
+    float x, y;
     const double z;
 };
 
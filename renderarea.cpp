@@ -49,40 +49,170 @@
 ****************************************************************************/
 
 #include "renderarea.h"
+#include "spankernel.h"
 
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QKeyEvent>
 #include <QPainter>
+#include <QResizeEvent>
 #include <QMouseEvent>
-#include <list>
+#include <QScreen>
+#include <QtMath>
 #include <algorithm>
-#include <functional>
-#include <iostream>
-#include <cmath>
 
 const int defaultWidth = 1200;
 const int defaultHeight = 600;
-const double colorCoeff = 0.8;
 const int offsetZStep = 20;
 const int expansionCoeffStep = 5;
+const float rotationDegreesPerPixel = 0.5f;
+const double fallbackRefreshRate = 60;
+const QRect overlayRect(8, 8, 280, 250);
+const int overlayPadding = 6;
+const int idleMsecs = 250;
 
 RenderArea::RenderArea(QWidget *parent)
     : QWidget(parent)
-    , cubePoints(defaultHeight, std::vector<bool>(defaultWidth))
-    , depths(defaultHeight, std::vector<double>(defaultWidth))
-    , colors(defaultHeight, std::vector<QColor>(defaultWidth))
-    , edgeColor(Qt::black)
-    , cubeColor(Qt::blue)
-    , globeColor(Qt::red)
-    , backgroundColor(Qt::white)
+    , frameSize(defaultWidth, defaultHeight)
+    , frameScale(1)
+    , eyeDistance(0)
+    , renderThread(defaultWidth, defaultHeight)
+    , picker(defaultWidth, defaultHeight)
+    , pendingEvents(0)
+    , submittedFrames(0)
+    , mergedEvents(0)
+    , overlayVisible(false)
+    , tracing(false)
+    , presentNsecs(0)
     , dragStarted(false)
-    , offsetX(200)
-    , offsetY(200)
-    , offsetZ(200)
-    , expansionCoeff(50)
+    , rotationStarted(false)
 {
     QPalette pal(palette());
-    pal.setColor(QPalette::Background, backgroundColor);
+    pal.setColor(QPalette::Background, scene.backgroundColor);
     setPalette(pal);
     setAutoFillBackground(true);
+    setFocusPolicy(Qt::StrongFocus);
+
+    frameTimer.setSingleShot(true);
+    frameTimer.setTimerType(Qt::PreciseTimer);
+    setFrameRateCap(0);
+    connect(&frameTimer, &QTimer::timeout, this, &RenderArea::submitFrame);
+    idleTimer.setSingleShot(true);
+    idleTimer.setInterval(idleMsecs);
+    connect(&idleTimer, &QTimer::timeout, this, &RenderArea::restoreResolution);
+    connect(&renderThread, &RenderThread::frameReady, this, [this] (const QRect &damage) {
+        const QRect widgetDamage = widgetRect(damage);
+        update(overlayVisible ? widgetDamage | overlayRect : widgetDamage);
+        const RenderStats stats = renderThread.frameStats();
+        // Every buffer is redrawn whole once after the frame size changes,
+        // which costs far more than the frames in between. Counting those
+        // would drop the scale again right after each step it takes.
+        if (idleTimer.isActive() && !stats.resized) {
+            const qreal fullWidth = width() * devicePixelRatioF() * frameScale;
+            if (governor.recordFrame(stats.frameNsecs(), stats.width / fullWidth)) {
+                updateFrameSize();
+            }
+        }
+    });
+
+    scene.mesh->boundingBox(meshBoxMin, meshBoxMax);
+    submittedMeshBounds = Renderer::meshBounds(scene, meshBoxMin, meshBoxMax);
+    renderThread.submit(scene, QRect(QPoint(0, 0), frameSize), frameSize);
+    renderThread.start();
+    sinceSubmit.start();
+}
+
+void RenderArea::setFrameRateCap(double framesPerSecond)
+{
+    if (framesPerSecond <= 0) {
+        const QScreen *screen = QGuiApplication::primaryScreen();
+        framesPerSecond = screen != nullptr && screen->refreshRate() > 0 ? screen->refreshRate() : fallbackRefreshRate;
+    }
+    frameInterval = std::max(qRound(1000 / framesPerSecond), 1);
+}
+
+void RenderArea::setPerspective(float distance)
+{
+    eyeDistance = distance;
+    // The spheres move with the projection as well.
+    updateFrameSize();
+}
+
+void RenderArea::setDepthFormat(DepthFormat format)
+{
+    scene.depthFormat = format;
+    // Intersections may land on other pixels at another precision.
+    pendingDamage = QRect(QPoint(0, 0), frameSize);
+    updateMesh();
+}
+
+void RenderArea::setSampleCount(int samples)
+{
+    scene.samples = samples;
+    pendingDamage = QRect(QPoint(0, 0), frameSize);
+    updateMesh();
+}
+
+void RenderArea::setEdgeStyle(float width, float depthBias)
+{
+    scene.edgeWidth = width;
+    scene.edgeDepthBias = depthBias;
+    // Wider edges reach past the bounds of the last frame's mesh.
+    pendingDamage = QRect(QPoint(0, 0), frameSize);
+    updateMesh();
+}
+
+void RenderArea::setRenderScale(qreal scale)
+{
+    frameScale = scale;
+    updateFrameSize();
+}
+
+void RenderArea::setFrameTimeBudget(double msecs)
+{
+    governor.setBudget(qRound64(msecs * 1e6));
+    restoreResolution();
+}
+
+void RenderArea::restoreResolution()
+{
+    if (governor.reset()) {
+        updateFrameSize();
+    }
+}
+
+void RenderArea::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    updateFrameSize();
+}
+
+qreal RenderArea::targetScale() const
+{
+    return devicePixelRatioF() * frameScale * governor.scale();
+}
+
+void RenderArea::updateFrameSize()
+{
+    const qreal scale = targetScale();
+    scene.pixelScale = static_cast<float>(scale);
+    frameSize = QSize(std::max(qCeil(width() * scale), 1), std::max(qCeil(height() * scale), 1));
+    picker.resize(frameSize.width(), frameSize.height());
+    // The eye stays in front of the middle of the widget.
+    scene.projection = eyeDistance > 0 ? Scene::perspective(eyeDistance, width() / 2.f, height() / 2.f) : QMatrix4x4();
+    pendingDamage = QRect(QPoint(0, 0), frameSize);
+    scheduleFrame();
+}
+
+QRect RenderArea::widgetRect(const QRect &frameRect) const
+{
+    const qreal scale = scene.pixelScale;
+    if (scale == 1) {
+        return frameRect;
+    }
+    // One more pixel around, which the filter reads when stretching.
+    const QRectF rect(frameRect.x() / scale, frameRect.y() / scale, frameRect.width() / scale, frameRect.height() / scale);
+    return rect.toAlignedRect().adjusted(-1, -1, 1, 1);
 }
 
 QSize RenderArea::minimumSizeHint() const
@@ -95,264 +225,196 @@ QSize RenderArea::sizeHint() const
     return QSize(defaultWidth, defaultHeight);
 }
 
-void RenderArea::fillCubeVertices() {
-    cubeVertices.clear();
-    cubeVertices.reserve(8);
-    cubeVertices.emplace_back(expansionCoeff * 0 + offsetX, expansionCoeff * 0 + offsetY, expansionCoeff * -3 + offsetZ);
-    cubeVertices.emplace_back(expansionCoeff * 0 + offsetX, expansionCoeff * 0 + offsetY, expansionCoeff * 3 + offsetZ);
-    cubeVertices.emplace_back(expansionCoeff * std::sqrt(6) + offsetX, expansionCoeff * -std::sqrt(2) + offsetY, expansionCoeff * -1 + offsetZ);
-    cubeVertices.emplace_back(expansionCoeff * 0 + offsetX, expansionCoeff * -2 * std::sqrt(2) + offsetY, expansionCoeff * 1 + offsetZ);
-    cubeVertices.emplace_back(expansionCoeff * std::sqrt(6) + offsetX, expansionCoeff * std::sqrt(2) + offsetY, expansionCoeff * 1 + offsetZ);
-    cubeVertices.emplace_back(expansionCoeff * -std::sqrt(6) + offsetX, expansionCoeff * -std::sqrt(2) + offsetY, expansionCoeff * -1 + offsetZ);
-    cubeVertices.emplace_back(expansionCoeff * 0 + offsetX, expansionCoeff * 2 * std::sqrt(2) + offsetY, expansionCoeff * -1 + offsetZ);
-    cubeVertices.emplace_back(expansionCoeff * -std::sqrt(6) + offsetX, expansionCoeff * std::sqrt(2) + offsetY, expansionCoeff * 1 + offsetZ);
+void RenderArea::setProfilerOverlayVisible(bool visible)
+{
+    overlayVisible = visible;
+    updateProfiling();
+    update(overlayRect);
+}
+
+void RenderArea::startTracing()
+{
+    tracing = true;
+    updateProfiling();
+}
 
+bool RenderArea::saveTrace(const QString &fileName, QString &errorMessage) const
+{
+    return profiler.writeChromeTrace(fileName, errorMessage);
 }
 
-void RenderArea::paintEvent(QPaintEvent * /* event */)
+void RenderArea::updateProfiling()
 {
-    for (auto&& rowOfDepths : depths) {
-        rowOfDepths.assign(defaultWidth, std::numeric_limits<double>::max());
+    renderThread.setProfiling(overlayVisible || tracing, tracing ? &profiler : nullptr);
+}
+
+void RenderArea::paintEvent(QPaintEvent *event)
+{
+    QElapsedTimer timer;
+    timer.start();
+    QPainter painter(this);
+    if (static_cast<float>(targetScale()) != scene.pixelScale) {
+        // Moved to a screen with another pixel ratio.
+        updateFrameSize();
     }
-    for (auto&& rowOfColors : colors) {
-        rowOfColors.assign(defaultWidth, backgroundColor);
+    const FrameBuffer *frame = renderThread.acquireFrame();
+    if (frame != nullptr && frame->image().size() == size()) {
+        const QRect damage = event->rect().intersected(frame->image().rect());
+        painter.drawImage(damage, frame->image(), damage);
+    } else if (frame != nullptr) {
+        // The painter is clipped to the damage, so only that much is
+        // stretched.
+        const qreal scale = scene.pixelScale;
+        painter.setRenderHint(QPainter::SmoothPixmapTransform, scale < devicePixelRatioF());
+        painter.drawImage(QRectF(0, 0, frame->width() / scale, frame->height() / scale), frame->image(),
+                          QRectF(frame->image().rect()));
     }
-    for (auto&& rowOfCubePoints : cubePoints) {
-        rowOfCubePoints.assign(defaultWidth, false);
+    renderThread.releaseFrame();
+    presentNsecs = timer.nsecsElapsed();
+    if (tracing) {
+        profiler.recordPresent(presentNsecs);
     }
 
-    QPainter painter(this);
+    if (overlayVisible) {
+        drawProfilerOverlay(painter);
+    }
+}
 
-    fillCubeVertices();
-
-    forEachPoint(cubeVertices[0], cubeVertices[2], [&] (double x, double y, double z, double) { updateCubePoints(x, y); updateDepth(x, y, z, edgeColor, 0); });
-    forEachPoint(cubeVertices[0], cubeVertices[5], [&] (double x, double y, double z, double) { updateCubePoints(x, y); updateDepth(x, y, z, edgeColor, 0); });
-    forEachPoint(cubeVertices[0], cubeVertices[6], [&] (double x, double y, double z, double) { updateCubePoints(x, y); updateDepth(x, y, z, edgeColor, 0); });
-    forEachPoint(cubeVertices[1], cubeVertices[3], [&] (double x, double y, double z, double) { updateCubePoints(x, y); updateDepth(x, y, z, edgeColor, 0); });
-    forEachPoint(cubeVertices[1], cubeVertices[4], [&] (double x, double y, double z, double) { updateCubePoints(x, y); updateDepth(x, y, z, edgeColor, 0); });
-    forEachPoint(cubeVertices[1], cubeVertices[7], [&] (double x, double y, double z, double) { updateCubePoints(x, y); updateDepth(x, y, z, edgeColor, 0); });
-    forEachPoint(cubeVertices[2], cubeVertices[3], [&] (double x, double y, double z, double) { updateCubePoints(x, y); updateDepth(x, y, z, edgeColor, 0); });
-    forEachPoint(cubeVertices[2], cubeVertices[4], [&] (double x, double y, double z, double) { updateCubePoints(x, y); updateDepth(x, y, z, edgeColor, 0); });
-    forEachPoint(cubeVertices[3], cubeVertices[5], [&] (double x, double y, double z, double) { updateCubePoints(x, y); updateDepth(x, y, z, edgeColor, 0); });
-    forEachPoint(cubeVertices[4], cubeVertices[6], [&] (double x, double y, double z, double) { updateCubePoints(x, y); updateDepth(x, y, z, edgeColor, 0); });
-    forEachPoint(cubeVertices[5], cubeVertices[7], [&] (double x, double y, double z, double) { updateCubePoints(x, y); updateDepth(x, y, z, edgeColor, 0); });
-    forEachPoint(cubeVertices[6], cubeVertices[7], [&] (double x, double y, double z, double) { updateCubePoints(x, y); updateDepth(x, y, z, edgeColor, 0); });
-
-    fillPlane(cubeVertices[3], cubeVertices[2], cubeVertices[0], cubeVertices[5]);
-    fillPlane(cubeVertices[2], cubeVertices[4], cubeVertices[6], cubeVertices[0]);
-    fillPlane(cubeVertices[0], cubeVertices[6], cubeVertices[7], cubeVertices[5]);
-    fillPlane(cubeVertices[3], cubeVertices[1], cubeVertices[7], cubeVertices[5]);
-    fillPlane(cubeVertices[2], cubeVertices[4], cubeVertices[1], cubeVertices[3]);
-    fillPlane(cubeVertices[1], cubeVertices[4], cubeVertices[6], cubeVertices[7]);
-
-    const int r = 100;
-    const int centerX = 200;
-    const int centerY = 200;
-    const int centerZ = 200;
-    for (int x = -r; x <= r; x++) {
-        const double absY = std::sqrt(r * r - x * x);
-        const int maxY = static_cast<int>(absY + 0.5);
-        const int minY = -maxY;
-        for (int y = minY; y <= maxY; y++) {
-            const double z = -std::sqrt(r * r - x * x - y * y) + centerZ;
-            updateDepth(x + centerX, y + centerY, z, globeColor, colorCoeff);
-        }
+void RenderArea::drawProfilerOverlay(QPainter &painter)
+{
+    const RenderStats stats = renderThread.frameStats();
+    const auto ms = [] (qint64 nsecs) { return QString::number(nsecs / 1e6, 'f', 2); };
+    QStringList lines;
+    lines << QString("kernel %1, depth %2, %3x").arg(spanKernelName(), depthFormatName(scene.depthFormat))
+                 .arg(scene.samples);
+    lines << QString("setup %1 ms, raster %2 ms").arg(ms(stats.setupNsecs), ms(stats.rasterNsecs));
+    for (int stage = 0; stage < RenderStats::StageCount; stage++) {
+        lines << QString("  %1 %2 ms cpu").arg(RenderStats::stageName(stage), ms(stats.stageNsecs[stage]));
     }
+    lines << QString("present %1 ms").arg(ms(presentNsecs));
+    lines << QString("fragments %1 tested").arg(stats.fragmentsTested);
+    lines << QString("  %1 passed, %2 rejected").arg(stats.fragmentsPassed).arg(stats.fragmentsRejected());
+    lines << QString("  %1 culled by hi-z").arg(stats.fragmentsCulled);
+    lines << QString("objects culled %1").arg(stats.culledObjects);
+    lines << QString("clears skipped %1 tiles").arg(stats.clearsSkipped);
+    lines << QString("resolution %1x%2, %3%").arg(stats.width).arg(stats.height).arg(qRound(governor.scale() * 100));
 
-    QImage image(defaultWidth, defaultHeight, QImage::Format_RGB888);
-    for (size_t row = 0; row < defaultHeight; row++) {
-        for (size_t column = 0; column < defaultWidth; column++) {
-            image.setPixelColor(column, row, colors[row][column]);
-        }
+    painter.fillRect(overlayRect, QColor(0, 0, 0, 160));
+    painter.setPen(Qt::white);
+    const int lineHeight = painter.fontMetrics().height();
+    int y = overlayRect.top() + overlayPadding + painter.fontMetrics().ascent();
+    for (const QString &line : lines) {
+        painter.drawText(overlayRect.left() + overlayPadding, y, line);
+        y += lineHeight;
     }
-    painter.drawImage(0, 0, image);
 }
 
-int RenderArea::fitColorToBounds(int color) {
-    if (color < 0) {
-        return 0;
-    }
-    if (color > 255) {
-        return 255;
+void RenderArea::updateMesh()
+{
+    if (governor.budget() > 0) {
+        idleTimer.start();
     }
-    return color;
+    scheduleFrame();
 }
 
-void RenderArea::updateCubePoints(double x, double y)  {
-    const int column = static_cast<int>(x + .5);
-    const int row = static_cast<int>(y + .5);
-    if (column < 0 || column >= defaultWidth || row < 0 || row >= defaultHeight) {
-        return;
+void RenderArea::scheduleFrame()
+{
+    // Input only edits the scene here. Everything that arrives before the
+    // next frame slot is folded into a single submission, and nothing is
+    // scheduled while the scene is unchanged.
+    pendingEvents++;
+    if (!frameTimer.isActive()) {
+        frameTimer.start(std::max(frameInterval - static_cast<int>(sinceSubmit.elapsed()), 0));
     }
-    cubePoints[row][column] = true;
 }
 
-void RenderArea::updateDepth(double x, double y, double z, const QColor& color, double colorCoeff) {
-    const int column = static_cast<int>(x + .5);
-    const int row = static_cast<int>(y + .5);
-    if (column < 0 || column >= defaultWidth || row < 0 || row >= defaultHeight) {
+void RenderArea::submitFrame()
+{
+    if (pendingEvents == 0) {
         return;
     }
-    if (depths[row][column] > z) {
-        colors[row][column] = QColor(
-                    fitColorToBounds(color.red() - z * colorCoeff),
-                    fitColorToBounds(color.green() - z * colorCoeff),
-                    fitColorToBounds(color.blue() - z * colorCoeff)
-                );
-        depths[row][column] = z;
-    }
+    // Input only ever moves the mesh, so the damage is where it was last
+    // drawn plus where it is now. The widget repaints once the frame is
+    // done.
+    const QRect bounds = scene.mesh->positions.empty() ? QRect() : Renderer::meshBounds(scene, meshBoxMin, meshBoxMax);
+    renderThread.submit(scene, submittedMeshBounds | bounds | pendingDamage, frameSize);
+    submittedMeshBounds = bounds;
+    pendingDamage = QRect();
+
+    mergedEvents += pendingEvents - 1;
+    pendingEvents = 0;
+    submittedFrames++;
+    sinceSubmit.restart();
+    emit frameSubmitted();
 }
 
 void RenderArea::mousePressEvent(QMouseEvent *event) {
-    if (cubeContains(event->x(), event->y())) {
+    if (event->button() == Qt::RightButton) {
+        rotationStarted = true;
+    } else if (picker.pick(scene, qFloor(event->x() * scene.pixelScale), qFloor(event->y() * scene.pixelScale))
+               == Renderer::MeshObject) {
         dragStarted = true;
-        prevPosition.setX(event->x());
-        prevPosition.setY(event->y());
-        update();
     }
+    prevPosition.setX(event->x());
+    prevPosition.setY(event->y());
 }
 
 void RenderArea::mouseMoveEvent(QMouseEvent *event) {
-    if (dragStarted == false) {
+    if (dragStarted == false && rotationStarted == false) {
         return;
     }
     const int diffX = event->x() - prevPosition.x();
     const int diffY = event->y() - prevPosition.y();
-    offsetX += diffX;
-    offsetY += diffY;
+    if (rotationStarted) {
+        // Turns the side facing the viewer along with the pointer.
+        QMatrix4x4 rotation;
+        rotation.rotate(-diffX * rotationDegreesPerPixel, 0, 1, 0);
+        rotation.rotate(diffY * rotationDegreesPerPixel, 1, 0, 0);
+        scene.model = rotation * scene.model;
+    } else {
+        scene.offsetX += diffX;
+        scene.offsetY += diffY;
+    }
     prevPosition.setX(event->x());
     prevPosition.setY(event->y());
-    update();
+    updateMesh();
 }
 
-void RenderArea::mouseReleaseEvent(QMouseEvent *event) {
+void RenderArea::mouseReleaseEvent(QMouseEvent * /* event */) {
     dragStarted = false;
-    update();
-}
-bool RenderArea::cubeContains(const int x, const int y) {
-    if (x < 0 || x >= defaultWidth || y < 0 || y >= defaultHeight) {
-        return false;
-    }
-    return cubePoints[y][x];
-}
-
-template<class T>
-void RenderArea::forEachPoint(const Point3D& p1, const Point3D& p2, T mapper) {
-    const int distanceX = p2.x - p1.x;
-    const int distanceY = p2.y - p1.y;
-    const int diffX = std::abs(distanceX);
-    const int diffY = std::abs(distanceY);
-    if (diffX > diffY) {
-        int sign;
-        if (p1.x > p2.x) {
-            sign = -1;
-        } else {
-            sign = 1;
-        }
-        for (int x = p1.x; ; x += sign) {
-            const double y = (x - p1.x) * (p2.y - p1.y) * 1. / (p2.x - p1.x) + p1.y;
-            const double t = (x - p1.x) * 1. / distanceX;
-            const double z = p1.z + t * (p2.z - p1.z);
-            mapper(x, y, z, t);
-            if (x == p2.x) {
-                break;
-            }
-        }
-    } else {
-        int sign;
-        if (p1.y > p2.y) {
-            sign = -1;
-        } else {
-            sign = 1;
-        }
-        for (int y = p1.y; ; y += sign) {
-            const double x = (y - p1.y) * 1. * (p2.x - p1.x) / (p2.y - p1.y) + p1.x;
-            const double t = (y - p1.y) * 1. / distanceY;
-            const double z = p1.z + t * (p2.z - p1.z);
-            mapper(x, y, z, t);
-            if (y == p2.y) {
-                break;
-            }
-        }
-    }
+    rotationStarted = false;
 }
 
-void RenderArea::fillPlane(const Point3D& p1, const Point3D& p2, const Point3D& p3, const Point3D& p4) {
-    Point3D points[] = {p1, p2, p3, p4};
-    size_t minXIndex = 0, maxXIndex = 0;
-    for (size_t i = 1; i < 4; i++) {
-        if (points[i].x < points[minXIndex].x) {
-            minXIndex = i;
-        }
-        if (points[i].x > points[maxXIndex].x) {
-            maxXIndex = i;
-        }
-    }
-    const Point3D& nextPoint = points[(minXIndex + 1) % 4];
-    const Point3D& nextNextPoint = points[(minXIndex + 2) % 4];
-    const Point3D& prevPoint = points[(minXIndex - 1 + 4) % 4];
-    const Point3D& prevPrevPoint = points[(minXIndex - 2 + 4) % 4];
-    Line3D a(points[minXIndex], prevPoint);
-    Line3D b(points[minXIndex], nextPoint);
-    Line3D a_star(a.p2, prevPrevPoint);
-    Line3D b_star(b.p2, nextNextPoint);
-
-    const int minX = points[minXIndex].x;
-    const int maxX = points[maxXIndex].x;
-
-    for (int x = minX; x <= maxX; x++) {
-        const Point3D minYPoint = std::min(
-                    findPointInLine(b, x, defaultHeight),
-                    findPointInLine(b_star, x, defaultHeight),
-                    [&] (const Point3D point1, const Point3D& point2) { return point1.y < point2.y; }
-        );
-        const Point3D maxYPoint = std::max(
-                    findPointInLine(a, x, 0),
-                    findPointInLine(a_star, x, 0),
-                    [&] (const Point3D point1, const Point3D& point2) { return point1.y < point2.y; }
-        );
-        for (int y = minYPoint.y; y <= maxYPoint.y; y++) {
-            double t = (y - minYPoint.y) * 1. / (maxYPoint.y - minYPoint.y);
-            double z = minYPoint.z + t * (maxYPoint.z - minYPoint.z);
-            updateCubePoints(x, y);
-            updateDepth(x, y, z, cubeColor, colorCoeff);
-        }
+void RenderArea::keyPressEvent(QKeyEvent *event) {
+    if (event->key() == Qt::Key_F3) {
+        setProfilerOverlayVisible(!overlayVisible);
+    } else {
+        QWidget::keyPressEvent(event);
     }
 }
 
-Point3D RenderArea::findPointInLine(const Line3D& line, const int x, const int defaultValue) {
-    if (x < std::min(line.x1, line.x2) || x > std::max(line.x1, line.x2)) {
-        return Point3D(x, defaultValue, std::numeric_limits<double>::max());
-    } else if (line.dx == 0) {
-        double t = (x - line.x1) * 1. / line.dx;
-    } else {
-        double t = (x - line.x1) * 1. / line.dx;
-        double z;
-        if (std::fabs(line.dz) < 0.000001) {
-            z = line.z1;
-        } else {
-            z = t * line.dz + line.z1;
-        }
-        return Point3D(x, static_cast<int>(t * line.dy + line.y1 + 0.5), z);
-    }
+void RenderArea::setMesh(std::shared_ptr<const Mesh> mesh) {
+    scene.mesh = std::move(mesh);
+    scene.mesh->boundingBox(meshBoxMin, meshBoxMax);
+    updateMesh();
 }
 
 void RenderArea::sizeIncClicked() {
-    expansionCoeff += expansionCoeffStep;
-    update();
+    scene.expansionCoeff += expansionCoeffStep;
+    updateMesh();
 }
 
 void RenderArea::sizeDecClicked() {
-    expansionCoeff -= expansionCoeffStep;
-    update();
+    scene.expansionCoeff -= expansionCoeffStep;
+    updateMesh();
 }
 
 void RenderArea::closenessIncClicked() {
-    offsetZ -= offsetZStep;
-    update();
+    scene.offsetZ -= offsetZStep;
+    updateMesh();
 }
 
 void RenderArea::closenessDecClicked() {
-    offsetZ += offsetZStep;
-    update();
+    scene.offsetZ += offsetZStep;
+    updateMesh();
 }
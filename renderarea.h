@@ -51,9 +51,13 @@
 #pragma once
 
 #include <QWidget>
+#include <QElapsedTimer>
 #include <QPen>
-#include "point3d.h"
-#include "line3d.h"
+#include <QTimer>
+#include "frameprofiler.h"
+#include "renderthread.h"
+#include "resolutiongovernor.h"
+#include "scene.h"
 
 class RenderArea : public QWidget
 {
@@ -64,36 +68,93 @@ public:
 
     QSize minimumSizeHint() const override;
     QSize sizeHint() const override;
+    void setMesh(std::shared_ptr<const Mesh> mesh);
+    // Upper bound on frames submitted per second; 0 follows the display
+    // refresh rate.
+    void setFrameRateCap(double framesPerSecond);
+    // Views the scene in perspective from eyeDistance pixels in front of
+    // the screen; 0 goes back to the orthographic view.
+    void setPerspective(float distance);
+    void setDepthFormat(DepthFormat format);
+    // 1, or 4 or 8 samples per pixel for multisample antialiasing.
+    void setSampleCount(int samples);
+    // Edges width pixels wide, drawn depthBias nearer than they are.
+    void setEdgeStyle(float width, float depthBias);
+    // Renders at scale times the resolution of the screen and stretches
+    // the frame over the widget, bilinearly filtered when it is smaller.
+    void setRenderScale(qreal scale);
+    qreal renderScale() const { return frameScale; }
+    // Lowers the resolution while the scene moves and frames take longer
+    // than msecs to render, and restores it once the scene is idle; 0
+    // keeps the resolution fixed.
+    void setFrameTimeBudget(double msecs);
+    int submittedFrameCount() const { return submittedFrames; }
+    // Input events folded into a frame together with an earlier one.
+    int mergedEventCount() const { return mergedEvents; }
+    int droppedSceneCount() const { return renderThread.droppedSceneCount(); }
+    // Shows per-stage timings and fragment counts of the latest frame over
+    // the picture. F3 toggles it as well.
+    void setProfilerOverlayVisible(bool visible);
+    // Records every following frame for saveTrace().
+    void startTracing();
+    bool saveTrace(const QString &fileName, QString &errorMessage) const;
     void sizeIncClicked();
     void sizeDecClicked();
     void closenessIncClicked();
     void closenessDecClicked();
 
+signals:
+    void frameSubmitted();
+
 protected:
     void paintEvent(QPaintEvent *event) override;
     void mousePressEvent(QMouseEvent *event) override;
     void mouseMoveEvent(QMouseEvent *event) override;
     void mouseReleaseEvent(QMouseEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
 private:
-    std::vector<Point3D> cubeVertices;
-    std::vector<std::vector<bool>> cubePoints;
-    std::vector<std::vector<double>> depths;
-    std::vector<std::vector<QColor>> colors;
-    QColor edgeColor;
-    QColor cubeColor;
-    QColor globeColor;
-    QColor backgroundColor;
+    qreal targetScale() const;
+    void updateFrameSize();
+    QRect widgetRect(const QRect &frameRect) const;
+    void updateMesh();
+    void scheduleFrame();
+    void submitFrame();
+    void restoreResolution();
+    void updateProfiling();
+    void drawProfilerOverlay(QPainter &painter);
+
+    Scene scene;
+    // Frames are rendered at frameSize, scene.pixelScale target pixels per
+    // widget pixel: the device pixel ratio times frameScale times the
+    // governor's scale.
+    QSize frameSize;
+    qreal frameScale;
+    ResolutionGovernor governor;
+    // Runs while the scene moves; frame times only steer the governor
+    // then.
+    QTimer idleTimer;
+    float eyeDistance;
+    RenderThread renderThread;
+    // Answers mouse presses on the GUI thread, without waiting for a frame.
+    Renderer picker;
+    // Model-space box around scene.mesh, so frame damage does not have to
+    // go over the vertices.
+    QVector3D meshBoxMin, meshBoxMax;
+    QRect submittedMeshBounds;
+    // Redrawn with the next frame on top of what the mesh covers.
+    QRect pendingDamage;
+    QTimer frameTimer;
+    QElapsedTimer sinceSubmit;
+    int frameInterval;
+    int pendingEvents;
+    int submittedFrames;
+    int mergedEvents;
+    FrameProfiler profiler;
+    bool overlayVisible;
+    bool tracing;
+    qint64 presentNsecs;
     bool dragStarted;
+    bool rotationStarted;
     QPoint prevPosition;
-    int offsetX, offsetY, offsetZ;
-    int expansionCoeff;
-    void fillCubeVertices();
-    template<class T>
-    void forEachPoint(const Point3D& p1, const Point3D& p2, T mapper);
-    void fillPlane(const Point3D& p1, const Point3D& p2, const Point3D& p3, const Point3D& p4);
-    void updateCubePoints(double x, double y);
-    void updateDepth(double x, double y, double z, const QColor& color, double colorCoeff);
-    bool cubeContains(const int x, const int y);
-    int fitColorToBounds(int color);
-    static Point3D findPointInLine(const Line3D& line, const int x, const int defaultValue);
 };
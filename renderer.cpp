@@ -0,0 +1,1600 @@
+#include "renderer.h"
+#include "samplebuffer.h"
+#include "spankernel.h"
+#include "vertexstage.h"
+
+#include <QElapsedTimer>
+#include <QVector4D>
+#include <QtConcurrentMap>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+const float colorCoeff = 0.8f;
+const int tileSize = 64;
+// Float rounding in the span kernel can land a fragment slightly closer
+// than the exact depth it was set up from, so occlusion bounds are pulled
+// this much (relative) towards the viewer.
+const double depthSlack = 1e-4;
+// Vertex positions are snapped to 1/subpixelScale of a pixel before
+// rasterization.
+const int subpixelBits = 8;
+const int subpixelScale = 1 << subpixelBits;
+// Smallest w a vertex may have; geometry closer to the eye plane is cut
+// off there.
+const float nearW = 1.f / 64;
+// How far outside the frame, in pixels, geometry may reach before it is
+// clipped. Keeps the fixed-point edge functions far from overflowing.
+const float guardBand = 4096;
+// Polygons whose vertices all lie this close (relative) to their plane are
+// scan converted as one plane; others are split into triangles.
+const double planarTolerance = 1e-5;
+
+namespace {
+
+float nearestBound(double z) {
+    return static_cast<float>(z - (std::abs(z) + 1) * depthSlack);
+}
+
+// Depth z as the hierarchical depth buffer compares it.
+template<class Depth>
+float depthKey(const Depth& format, float z) {
+    return Depth::key(format.encode(z));
+}
+
+// Bits of the clip-space tests a vertex fails. The first four are the
+// edges of the cull window, the frame or less, and only decide whether a
+// primitive is visible at all; the others are planes primitives are
+// actually cut at.
+enum Outcode {
+    OutsideLeft = 1 << 0,
+    OutsideRight = 1 << 1,
+    OutsideTop = 1 << 2,
+    OutsideBottom = 1 << 3,
+    BeforeNear = 1 << 4,
+    BeyondGuardLeft = 1 << 5,
+    BeyondGuardRight = 1 << 6,
+    BeyondGuardTop = 1 << 7,
+    BeyondGuardBottom = 1 << 8,
+    // Set on vertices no primitive that is drawn uses, while picking.
+    Unused = 1 << 9
+};
+const int clipPlanes = BeforeNear | BeyondGuardLeft | BeyondGuardRight | BeyondGuardTop | BeyondGuardBottom;
+
+struct ClipVertex {
+    float x, y, z, w;
+
+    ClipVertex lerp(const ClipVertex& to, float t) const {
+        return {x + t * (to.x - x), y + t * (to.y - y), z + t * (to.z - z), w + t * (to.w - w)};
+    }
+};
+
+// Signed distance of v from one of the clipPlanes; inside is >= 0.
+float planeDistance(int plane, const ClipVertex& v, const QSize& size) {
+    switch (plane) {
+    case BeforeNear:
+        return v.w - nearW;
+    case BeyondGuardLeft:
+        return v.x + guardBand * v.w;
+    case BeyondGuardRight:
+        return (size.width() + guardBand) * v.w - v.x;
+    case BeyondGuardTop:
+        return v.y + guardBand * v.w;
+    default:
+        return (size.height() + guardBand) * v.w - v.y;
+    }
+}
+
+int outcode(const ClipVertex& v, const QRectF& window, const QSize& size) {
+    int code = 0;
+    code |= v.x < window.left() * v.w ? OutsideLeft : 0;
+    code |= v.x > window.right() * v.w ? OutsideRight : 0;
+    code |= v.y < window.top() * v.w ? OutsideTop : 0;
+    code |= v.y > window.bottom() * v.w ? OutsideBottom : 0;
+    for (int plane = BeforeNear; plane <= BeyondGuardBottom; plane <<= 1) {
+        code |= planeDistance(plane, v, size) < 0 ? plane : 0;
+    }
+    return code;
+}
+
+// Sutherland-Hodgman: cuts polygon down to the side of every plane in
+// planes it has to be inside of. scratch is working memory.
+void clipPolygon(std::vector<ClipVertex>& polygon, std::vector<ClipVertex>& scratch, int planes, const QSize& size) {
+    for (int plane = BeforeNear; plane <= BeyondGuardBottom && polygon.size() >= 3; plane <<= 1) {
+        if ((planes & plane) == 0) {
+            continue;
+        }
+        scratch.clear();
+        for (size_t i = 0; i < polygon.size(); i++) {
+            const ClipVertex& from = polygon[i];
+            const ClipVertex& to = polygon[(i + 1) % polygon.size()];
+            const float fromDistance = planeDistance(plane, from, size);
+            const float toDistance = planeDistance(plane, to, size);
+            if (fromDistance >= 0) {
+                scratch.push_back(from);
+            }
+            if ((fromDistance >= 0) != (toDistance >= 0)) {
+                scratch.push_back(from.lerp(to, fromDistance / (fromDistance - toDistance)));
+            }
+        }
+        polygon.swap(scratch);
+    }
+}
+
+// Polygon addPrimitive is clipping and the working memory of clipPolygon,
+// kept from one primitive to the next so clipping does not allocate.
+struct ClipScratch {
+    std::vector<ClipVertex> polygon;
+    std::vector<ClipVertex> scratch;
+};
+
+ClipScratch& setupClipScratch() {
+    thread_local ClipScratch scratch;
+    return scratch;
+}
+
+// Cuts the segment from a to b at every plane in planes. Returns false if
+// nothing of it is left.
+bool clipSegment(ClipVertex& a, ClipVertex& b, int planes, const QSize& size) {
+    float from = 0, to = 1;
+    for (int plane = BeforeNear; plane <= BeyondGuardBottom; plane <<= 1) {
+        if ((planes & plane) == 0) {
+            continue;
+        }
+        const float aDistance = planeDistance(plane, a, size);
+        const float bDistance = planeDistance(plane, b, size);
+        if (aDistance < 0 && bDistance < 0) {
+            return false;
+        }
+        if (aDistance < 0) {
+            from = std::max(from, aDistance / (aDistance - bDistance));
+        } else if (bDistance < 0) {
+            to = std::min(to, aDistance / (aDistance - bDistance));
+        }
+    }
+    if (from > to) {
+        return false;
+    }
+    const ClipVertex start = a.lerp(b, from);
+    b = a.lerp(b, to);
+    a = start;
+    return true;
+}
+
+ClipVertex clipVertexAt(const ClipVertices& vertices, int index) {
+    return {vertices.x[index], vertices.y[index], vertices.z[index], vertices.w[index]};
+}
+
+Point3D screenVertex(const ClipVertex& v) {
+    return Point3D(v.x / v.w, v.y / v.w, v.z / v.w);
+}
+
+int clampToInt(double value) {
+    const double limit = std::numeric_limits<int>::max() / 2;
+    return static_cast<int>(std::min(std::max(value, -limit), limit));
+}
+
+// Pixels whose sample points may fall between the given coordinates
+// widened by reach.
+QRect pixelBounds(double left, double top, double right, double bottom, double reach = 0) {
+    return QRect(QPoint(clampToInt(std::floor(left - reach)), clampToInt(std::floor(top - reach))),
+                 QPoint(clampToInt(std::ceil(right + reach)), clampToInt(std::ceil(bottom + reach))));
+}
+
+// How far beyond its outline a primitive may cover pixels. Multisampled,
+// samples lie up to half a pixel from the sample point and edges are a
+// pixel wide.
+double coverageReach(int samples) {
+    return samplePattern(samples) != nullptr ? 1 : 0;
+}
+
+// How far beyond its outline an edge width pixels wide may cover pixels.
+// A single-sampled line covers a run of pixels across its minor axis, at
+// most width times the square root of two of them on diagonals.
+double lineReach(int samples, float width) {
+    if (samplePattern(samples) != nullptr) {
+        return width / 2. + 0.5;
+    }
+    return (std::max(qRound(width * std::sqrt(2.f)), 1) - 1) / 2.;
+}
+
+// A tile is drawn by one worker from start to resolve, so the samples only
+// need to live that long and one buffer per thread does.
+SampleBuffer& workerSamples() {
+    thread_local SampleBuffer samples;
+    return samples;
+}
+
+}
+
+Renderer::Renderer(int width, int height)
+    : frameBuffer(width, height)
+    , hiZ(frameBuffer.depths)
+    , sphereDepthScale(1)
+    , edgeWidth(1)
+    , edgeDepthBias(0)
+    , invalid(true)
+    , sampleCount(1)
+    , profiling(false)
+    , writeObjectIds(false)
+{
+    setUpTiles();
+}
+
+void Renderer::resize(int width, int height) {
+    if (width == frameBuffer.width() && height == frameBuffer.height()) {
+        return;
+    }
+    frameBuffer.resize(width, height);
+    hiZ.resize();
+    setUpTiles();
+    invalid = true;
+}
+
+void Renderer::setUpTiles() {
+    const int width = frameBuffer.width();
+    const int height = frameBuffer.height();
+    tileColumns = (width + tileSize - 1) / tileSize;
+    const int tileRows = (height + tileSize - 1) / tileSize;
+    const QRect frameRect(0, 0, width, height);
+    tiles.resize(tileRows * tileColumns);
+    for (int row = 0; row < tileRows; row++) {
+        for (int column = 0; column < tileColumns; column++) {
+            Tile& tile = tiles[row * tileColumns + column];
+            tile.rect = QRect(column * tileSize, row * tileSize, tileSize, tileSize).intersected(frameRect);
+            tile.cleared = false;
+        }
+    }
+}
+
+void Renderer::projectVertices(const Scene& scene) {
+    transformVertices(scene.meshTransform(), scene.mesh->positions, clipVertices);
+    const QSize size(frameBuffer.width(), frameBuffer.height());
+    const QRectF window(cullRect);
+    const int count = clipVertices.size();
+    vertices.clear();
+    vertices.reserve(count);
+    outcodes.resize(count);
+    for (int i = 0; i < count; i++) {
+        outcodes[i] = static_cast<quint16>(outcode(clipVertexAt(clipVertices, i), window, size));
+    }
+    if (writeObjectIds) {
+        markPickedVertices(*scene.mesh);
+    }
+    for (int i = 0; i < count; i++) {
+        // Vertices before the near plane get a meaningless position; every
+        // primitive using them goes through clipping instead. Unused ones
+        // are not looked at.
+        const bool unused = outcodes[i] & (BeforeNear | Unused);
+        vertices.push_back(unused ? Point3D(0, 0, 0) : screenVertex(clipVertexAt(clipVertices, i)));
+    }
+}
+
+void Renderer::markPickedVertices(const Mesh& mesh) {
+    // Only the few primitives around the picked pixel are drawn, so only
+    // their vertices need a screen position.
+    for (quint16& code : outcodes) {
+        code |= Unused;
+    }
+    const auto use = [&] (const quint32* indices, int count) {
+        int inside = ~0;
+        for (int i = 0; i < count; i++) {
+            inside &= outcodes[indices[i]];
+        }
+        if ((inside & ~Unused) != 0) {
+            return;
+        }
+        for (int i = 0; i < count; i++) {
+            outcodes[indices[i]] &= ~Unused;
+        }
+    };
+    for (int edge = 0; edge < mesh.edgeCount(); edge++) {
+        use(&mesh.edges[2 * edge], 2);
+    }
+    for (int face = 0; face < mesh.faceCount(); face++) {
+        use(mesh.faceIndices(face), mesh.faceSize(face));
+    }
+}
+
+QRect Renderer::meshBounds(const Scene& scene) {
+    QVector3D boxMin, boxMax;
+    if (!scene.mesh->boundingBox(boxMin, boxMax)) {
+        return QRect();
+    }
+    return meshBounds(scene, boxMin, boxMax);
+}
+
+QRect Renderer::meshBounds(const Scene& scene, const QVector3D& boxMin, const QVector3D& boxMax) {
+    // With every corner in front of the eye the projection of the box is
+    // the convex hull of the projected corners, and the mesh lies inside.
+    const QMatrix4x4 transform = scene.meshTransform();
+    const double reach = std::max(coverageReach(scene.samples), lineReach(scene.samples, scene.edgeWidth));
+    QRect bounds;
+    for (int corner = 0; corner < 8; corner++) {
+        const QVector4D clip = transform.map(QVector4D(corner & 1 ? boxMax.x() : boxMin.x(),
+                                                       corner & 2 ? boxMax.y() : boxMin.y(),
+                                                       corner & 4 ? boxMax.z() : boxMin.z(), 1));
+        if (clip.w() < nearW) {
+            // Part of the mesh may lie behind the eye, so it may reach any
+            // pixel.
+            const int limit = std::numeric_limits<int>::max() / 2;
+            return QRect(QPoint(-limit, -limit), QPoint(limit, limit));
+        }
+        const double x = clip.x() / clip.w();
+        const double y = clip.y() / clip.w();
+        bounds |= pixelBounds(x, y, x, y, reach);
+    }
+    return bounds;
+}
+
+void Renderer::render(const Scene& scene, const QRect& scissor) {
+    QElapsedTimer timer;
+    timer.start();
+    const QRect frameRect(0, 0, frameBuffer.width(), frameBuffer.height());
+    if (scene.depthFormat != frameBuffer.depths.format()) {
+        frameBuffer.depths.setFormat(scene.depthFormat);
+        for (auto&& tile : tiles) {
+            tile.cleared = false;
+        }
+        invalid = true;
+    }
+    if (scene.samples != sampleCount && !writeObjectIds) {
+        sampleCount = scene.samples;
+        invalid = true;
+    }
+    QRect clip = scissor.intersected(frameRect);
+    // Nothing outside the scissor can be kept from an invalid frame.
+    // Picking only needs its one pixel right.
+    if (invalid && !writeObjectIds) {
+        clip = frameRect;
+        invalid = false;
+    }
+    frameStats = RenderStats();
+    frameStats.width = frameBuffer.width();
+    frameStats.height = frameBuffer.height();
+    // Primitives wholly to one side of cullRect are dropped before they are
+    // sorted. A frame keeps everything on screen; a pick only what may
+    // cover its pixel.
+    cullRect = frameRect;
+    if (writeObjectIds) {
+        const double maxReach = std::max(coverageReach(sampleCount), lineReach(sampleCount, scene.edgeWidth));
+        const int reach = static_cast<int>(std::ceil(maxReach));
+        cullRect = clip.adjusted(-reach - 1, -reach - 1, reach + 1, reach + 1);
+    }
+    projectVertices(scene);
+    buildCommands(scene);
+    sortObjects();
+    binCommands(clip);
+    frameStats.setupNsecs = timer.nsecsElapsed();
+    timer.start();
+
+    QtConcurrent::blockingMap(tiles, [&] (Tile& tile) { renderTile(tile, scene, clip); });
+    frameStats.rasterNsecs = timer.nsecsElapsed();
+    collectStats();
+}
+
+Renderer::ObjectId Renderer::pick(const Scene& scene, int x, int y) {
+    const QRect pixel(x, y, 1, 1);
+    if (!QRect(0, 0, frameBuffer.width(), frameBuffer.height()).contains(pixel)) {
+        return NoObject;
+    }
+    frameBuffer.objectIds.fill(pixel, NoObject);
+    writeObjectIds = true;
+    render(scene, pixel);
+    writeObjectIds = false;
+    return static_cast<ObjectId>(frameBuffer.objectIds.row(y)[x]);
+}
+
+namespace {
+
+template<class T>
+bool nearerThan(const T& a, const T& b) {
+    return a.nearestZ < b.nearestZ;
+}
+
+}
+
+void Renderer::buildCommands(const Scene& scene) {
+    const Mesh& mesh = *scene.mesh;
+    unsortedCommands.clear();
+    objects.clear();
+    clippedIndices.clear();
+    edgeWidth = scene.edgeWidth;
+    edgeDepthBias = scene.edgeDepthBias;
+    // Edges stay ahead of faces, so an edge still wins against a face at
+    // the same depth. Inside each group primitives go front-to-back.
+    for (int edge = 0; edge < mesh.edgeCount(); edge++) {
+        addPrimitive(DrawCommand::Edge, 2 * edge, &mesh.edges[2 * edge], 2);
+    }
+    std::stable_sort(unsortedCommands.begin(), unsortedCommands.end(), nearerThan<DrawCommand>);
+    const int firstFace = static_cast<int>(unsortedCommands.size());
+    for (int face = 0; face < mesh.faceCount(); face++) {
+        addPrimitive(DrawCommand::Face, mesh.faceStarts[face], mesh.faceIndices(face), mesh.faceSize(face));
+    }
+    std::stable_sort(unsortedCommands.begin() + firstFace, unsortedCommands.end(), nearerThan<DrawCommand>);
+    addObject(MeshObject, 0);
+
+    // A sphere is drawn as the circle around its projected center with the
+    // radius scaled by pixelScale and the same 1 / w. That is exact for
+    // orthographic views and close enough for spheres that are small against
+    // the eye distance. Depth is not scaled by pixelScale, so the front of
+    // the sphere is 1 / pixelScale deep per pixel of radius.
+    const QMatrix4x4 viewProjection = scene.viewProjection();
+    sphereDepthScale = 1 / scene.pixelScale;
+    screenSpheres.clear();
+    const int firstSphere = static_cast<int>(unsortedCommands.size());
+    for (const Sphere& sphere : *scene.spheres) {
+        const QVector4D center = viewProjection.map(QVector4D(sphere.center.x(), sphere.center.y(), sphere.center.z(), 1));
+        if (center.w() < nearW) {
+            frameStats.primitivesOutside++;
+            continue;
+        }
+        const Sphere onScreen = {QVector3D(center.x() / center.w(), center.y() / center.w(), center.z() / center.w()),
+                                 sphere.radius * scene.pixelScale / center.w()};
+        const QRect bounds = pixelBounds(onScreen.center.x() - onScreen.radius, onScreen.center.y() - onScreen.radius,
+                                         onScreen.center.x() + onScreen.radius, onScreen.center.y() + onScreen.radius,
+                                         coverageReach(sampleCount));
+        if (!bounds.intersects(cullRect)) {
+            frameStats.primitivesOutside++;
+            continue;
+        }
+        unsortedCommands.push_back({DrawCommand::Sphere, static_cast<int>(screenSpheres.size()), 1, false, bounds,
+                                    nearestBound(onScreen.center.z() - onScreen.radius * sphereDepthScale), 0});
+        screenSpheres.push_back(onScreen);
+    }
+    std::stable_sort(unsortedCommands.begin() + firstSphere, unsortedCommands.end(), nearerThan<DrawCommand>);
+    addObject(SphereObject, firstSphere);
+}
+
+void Renderer::addPrimitive(DrawCommand::Kind kind, int first, const quint32* indices, int count) {
+    int inside = ~0, crossed = 0;
+    for (int i = 0; i < count; i++) {
+        inside &= outcodes[indices[i]];
+        crossed |= outcodes[indices[i]];
+    }
+    if (inside != 0) {
+        // Every vertex is on the far side of one plane, so is the primitive.
+        frameStats.primitivesOutside++;
+        return;
+    }
+    // Edges are tested at their biased depth, which culling has to see too.
+    const double reach = kind == DrawCommand::Edge ? lineReach(sampleCount, edgeWidth) : coverageReach(sampleCount);
+    const float bias = kind == DrawCommand::Edge ? edgeDepthBias : 0;
+    if ((crossed & clipPlanes) == 0) {
+        unsortedCommands.push_back({kind, first, count, false, vertexBounds(indices, count, reach),
+                                    vertexNearestZ(indices, count) - bias, 0});
+        return;
+    }
+
+    const QSize size(frameBuffer.width(), frameBuffer.height());
+    ClipScratch& clipScratch = setupClipScratch();
+    std::vector<ClipVertex>& polygon = clipScratch.polygon;
+    polygon.clear();
+    for (int i = 0; i < count; i++) {
+        polygon.push_back(clipVertexAt(clipVertices, indices[i]));
+    }
+    if (kind == DrawCommand::Edge) {
+        if (!clipSegment(polygon[0], polygon[1], crossed & clipPlanes, size)) {
+            frameStats.primitivesOutside++;
+            return;
+        }
+    } else {
+        clipPolygon(polygon, clipScratch.scratch, crossed & clipPlanes, size);
+        if (polygon.size() < 3) {
+            frameStats.primitivesOutside++;
+            return;
+        }
+    }
+    frameStats.primitivesClipped++;
+    const int clippedFirst = static_cast<int>(clippedIndices.size());
+    for (const ClipVertex& vertex : polygon) {
+        clippedIndices.push_back(static_cast<quint32>(vertices.size()));
+        vertices.push_back(screenVertex(vertex));
+    }
+    const quint32* clipped = clippedIndices.data() + clippedFirst;
+    const int clippedCount = static_cast<int>(polygon.size());
+    unsortedCommands.push_back({kind, clippedFirst, clippedCount, true, vertexBounds(clipped, clippedCount, reach),
+                                vertexNearestZ(clipped, clippedCount) - bias, 0});
+}
+
+const quint32* Renderer::commandIndices(const DrawCommand& command, const Mesh& mesh) const {
+    if (command.clipped) {
+        return clippedIndices.data() + command.first;
+    }
+    return (command.kind == DrawCommand::Edge ? mesh.edges.data() : mesh.indices.data()) + command.first;
+}
+
+void Renderer::addObject(ObjectId id, int firstCommand) {
+    const int commandCount = static_cast<int>(unsortedCommands.size()) - firstCommand;
+    if (commandCount == 0) {
+        return;
+    }
+    DrawObject object = {id, firstCommand, commandCount, QRect(), std::numeric_limits<float>::max()};
+    for (int i = firstCommand; i < firstCommand + commandCount; i++) {
+        object.bounds |= unsortedCommands[i].bounds;
+        object.nearestZ = std::min(object.nearestZ, unsortedCommands[i].nearestZ);
+    }
+    objects.push_back(object);
+}
+
+void Renderer::sortObjects() {
+    std::stable_sort(objects.begin(), objects.end(), nearerThan<DrawObject>);
+    commands.clear();
+    for (int i = 0; i < static_cast<int>(objects.size()); i++) {
+        DrawObject& object = objects[i];
+        const auto first = unsortedCommands.begin() + object.firstCommand;
+        object.firstCommand = static_cast<int>(commands.size());
+        for (auto command = first; command != first + object.commandCount; ++command) {
+            commands.push_back(*command);
+            commands.back().object = i;
+        }
+    }
+}
+
+void Renderer::binCommands(const QRect& scissor) {
+    for (auto&& tile : tiles) {
+        tile.commands.clear();
+        tile.drawnObjects.clear();
+        tile.stats = RenderStats();
+    }
+    for (int i = 0; i < static_cast<int>(commands.size()); i++) {
+        const QRect bounds = commands[i].bounds.intersected(scissor);
+        if (bounds.isEmpty()) {
+            continue;
+        }
+        for (int row = bounds.top() / tileSize; row <= bounds.bottom() / tileSize; row++) {
+            for (int column = bounds.left() / tileSize; column <= bounds.right() / tileSize; column++) {
+                tiles[row * tileColumns + column].commands.push_back(i);
+            }
+        }
+    }
+}
+
+namespace {
+
+RenderStats::Stage stageOf(int kind) {
+    static const RenderStats::Stage stages[] = {RenderStats::Edges, RenderStats::Faces, RenderStats::Spheres};
+    return stages[kind];
+}
+
+}
+
+void Renderer::renderTile(Tile& tile, const Scene& scene, const QRect& scissor) {
+    tile.clip = tile.rect.intersected(scissor);
+    if (tile.clip.isEmpty()) {
+        return;
+    }
+    switch (scene.depthFormat) {
+    case DepthFormat::ReverseFloat32:
+        drawTile(tile, scene, ReverseFloatDepth(scene.depthNear, scene.depthFar));
+        break;
+    case DepthFormat::Unorm24:
+        drawTile(tile, scene, Unorm24Depth(scene.depthNear, scene.depthFar));
+        break;
+    case DepthFormat::Unorm16:
+        drawTile(tile, scene, Unorm16Depth(scene.depthNear, scene.depthFar));
+        break;
+    default:
+        drawTile(tile, scene, FloatDepth(scene.depthNear, scene.depthFar));
+        break;
+    }
+}
+
+template<class Depth>
+void Renderer::drawTile(Tile& tile, const Scene& scene, const Depth& format) {
+    const QRect& clip = tile.clip;
+    // Commands of one kind mostly come in runs, so the clock is only read
+    // when the stage changes.
+    QElapsedTimer timer;
+    int stage = RenderStats::Clear;
+    if (profiling) {
+        timer.start();
+    }
+    const auto enterStage = [&] (int nextStage) {
+        if (profiling && nextStage != stage) {
+            tile.stats.stageNsecs[stage] += timer.nsecsElapsed();
+            timer.start();
+        }
+        stage = nextStage;
+    };
+
+    const QRgb background = scene.backgroundColor.rgb();
+    if (tile.cleared && tile.clearedColor == background) {
+        tile.stats.clearsSkipped++;
+    } else {
+        frameBuffer.clear(clip, background);
+        tile.cleared = clip == tile.rect;
+        tile.clearedColor = background;
+    }
+    hiZ.reset(clip, Depth::key(Depth::farthest()));
+    const SamplePattern* pattern = writeObjectIds ? nullptr : samplePattern(sampleCount);
+    tile.samples = nullptr;
+    if (pattern != nullptr) {
+        tile.samples = &workerSamples();
+        tile.samples->reset(clip, *pattern, Depth::key(Depth::farthest()));
+    }
+
+    // Edges are collected and drawn as one list, with the setup they share
+    // done once, as soon as anything else comes up.
+    ObjectId linesId = NoObject;
+    const auto drawPendingLines = [&] () {
+        if (!tile.lines.empty()) {
+            drawLines(tile.lines, scene.edgeColor, linesId, tile, format);
+            tile.lines.clear();
+        }
+    };
+
+    const Mesh& mesh = *scene.mesh;
+    int object = -1;
+    bool objectOccluded = false;
+    tile.lines.clear();
+    for (int index : tile.commands) {
+        const DrawCommand& command = commands[index];
+        if (command.kind != DrawCommand::Edge) {
+            drawPendingLines();
+        }
+        enterStage(stageOf(command.kind));
+        if (command.object != object) {
+            object = command.object;
+            objectOccluded = hiZ.occludes(objects[object].bounds.intersected(clip), depthKey(format, objects[object].nearestZ));
+            if (!objectOccluded) {
+                tile.drawnObjects.push_back(object);
+            }
+        }
+        if (objectOccluded || hiZ.occludes(command.bounds.intersected(clip), depthKey(format, command.nearestZ))) {
+            continue;
+        }
+        const ObjectId id = objects[object].id;
+        switch (command.kind) {
+        case DrawCommand::Edge: {
+            const quint32* edge = commandIndices(command, mesh);
+            tile.lines.push_back(edge[0]);
+            tile.lines.push_back(edge[1]);
+            linesId = id;
+            break;
+        }
+        case DrawCommand::Face:
+            fillPolygon(commandIndices(command, mesh), command.count, scene.cubeColor, id, tile, format);
+            break;
+        case DrawCommand::Sphere:
+            fillSphere(screenSpheres[command.first], scene.sphereColor, id, tile, format);
+            break;
+        }
+    }
+    drawPendingLines();
+    if (tile.samples != nullptr) {
+        enterStage(RenderStats::Resolve);
+        tile.samples->resolve(frameBuffer.colors);
+        tile.samples = nullptr;
+    }
+    enterStage(RenderStats::StageCount);
+    if (tile.stats.fragmentsPassed > 0) {
+        tile.cleared = false;
+    }
+}
+
+void Renderer::collectStats() {
+    std::vector<uint8_t> binned(objects.size(), 0);
+    std::vector<uint8_t> drawn(objects.size(), 0);
+    for (const Tile& tile : tiles) {
+        frameStats.addTile(tile.stats);
+        for (int index : tile.commands) {
+            binned[commands[index].object] = 1;
+        }
+        for (int object : tile.drawnObjects) {
+            drawn[object] = 1;
+        }
+    }
+    for (size_t i = 0; i < objects.size(); i++) {
+        if (binned[i] && !drawn[i]) {
+            frameStats.culledObjects++;
+        }
+    }
+}
+
+QRect Renderer::vertexBounds(const quint32* indices, int count, double reach) const {
+    float left = vertices[indices[0]].x, right = left;
+    float top = vertices[indices[0]].y, bottom = top;
+    for (int i = 1; i < count; i++) {
+        const Point3D& vertex = vertices[indices[i]];
+        left = std::min(left, vertex.x);
+        right = std::max(right, vertex.x);
+        top = std::min(top, vertex.y);
+        bottom = std::max(bottom, vertex.y);
+    }
+    return pixelBounds(left, top, right, bottom, reach);
+}
+
+float Renderer::vertexNearestZ(const quint32* indices, int count) const {
+    double nearest = vertices[indices[0]].z;
+    for (int i = 1; i < count; i++) {
+        nearest = std::min(nearest, vertices[indices[i]].z);
+    }
+    return nearestBound(nearest);
+}
+
+template<class Depth>
+void Renderer::fillSphere(const Sphere& sphere, const QColor& color, ObjectId id, Tile& tile, const Depth& format) {
+    if (tile.samples != nullptr) {
+        fillSphereSamples(sphere, color, tile, format);
+        return;
+    }
+    const QRect& clip = tile.clip;
+    const float centerX = sphere.center.x();
+    const float centerY = sphere.center.y();
+    const float centerZ = sphere.center.z();
+    const float radius = sphere.radius;
+    const int fromY = std::max(static_cast<int>(std::ceil(centerY - radius)), clip.top());
+    const int toY = std::min(static_cast<int>(std::floor(centerY + radius)), clip.bottom());
+    const QRgb rgb = color.rgb();
+    for (int y = fromY; y <= toY; y++) {
+        const float dy = y - centerY;
+        const float rowQ = radius * radius - dy * dy;
+        if (rowQ < 0) {
+            continue;
+        }
+        // The row is clipped once; the kernel then takes every square root
+        // of the span in its vector lanes.
+        const double halfWidth = std::sqrt(static_cast<double>(rowQ));
+        const int fromX = std::max(static_cast<int>(std::ceil(centerX - halfWidth)), clip.left());
+        const int toX = std::min(static_cast<int>(std::floor(centerX + halfWidth)), clip.right());
+        if (fromX > toX) {
+            continue;
+        }
+        const int count = toX - fromX + 1;
+        const float dx0 = fromX - centerX;
+        // The span is nearest to the viewer where it passes closest to the
+        // center column.
+        const float nearestDx = std::min(std::max(0.f, dx0), static_cast<float>(toX - centerX));
+        if (hiZ.occludesSpan(y, fromX, toX, depthKey(format, sphereZ(nearestDx, rowQ, centerZ, sphereDepthScale)))) {
+            tile.stats.fragmentsCulled += count;
+            continue;
+        }
+        uint8_t* ids = objectIdRow(y);
+        const int passed = shadeSphereSpan(frameBuffer.colors.row(y) + fromX,
+                                           frameBuffer.depths.row<typename Depth::Value>(y) + fromX, format, count,
+                                           dx0, rowQ, centerZ, sphereDepthScale, rgb, colorCoeff,
+                                           ids != nullptr ? ids + fromX : nullptr, id);
+        if (passed > 0) {
+            hiZ.markWritten(y, fromX, toX);
+        }
+        tile.stats.fragmentsTested += count;
+        tile.stats.fragmentsPassed += passed;
+    }
+}
+
+namespace {
+
+// One in the 32.32 fixed point lines step their minor coordinate in.
+const qint64 lineFixedOne = qint64(1) << 32;
+
+// A segment walked one pixel at a time along its major axis, the one it
+// covers more of. Each step covers a run of thickness pixels across, the
+// first of them at fixed-point minor coordinate minorOrigin + m * minorStep
+// for major coordinate m, so stepping is an integer addition and the same
+// pixels come out whichever pixel a tile starts at. The first and last
+// pixels may lie up to half a pixel beyond the ends; they are clamped to
+// the end, in depth as well.
+struct LineSetup {
+    LineSetup(const Point3D& p1, const Point3D& p2, float width, float depthBias) {
+        const double dx = p2.x - p1.x;
+        const double dy = p2.y - p1.y;
+        steep = !(std::abs(dx) > std::abs(dy));
+        const double major1 = steep ? p1.y : p1.x;
+        const double major2 = steep ? p2.y : p2.x;
+        const double minor1 = steep ? p1.x : p1.y;
+        const double minor2 = steep ? p2.x : p2.y;
+        const double length = major2 - major1;
+        const double slope = length != 0 ? (minor2 - minor1) / length : 0;
+        const double zSlope = length != 0 ? (p2.z - p1.z) / length : 0;
+        const auto nearest = [] (double value) { return static_cast<int>(std::floor(value + .5)); };
+        from = nearest(std::min(major1, major2));
+        to = nearest(std::max(major1, major2));
+        thickness = std::max(qRound(width * std::sqrt(1 + slope * slope)), 1);
+        // Rounding to the nearest pixel and centering the run on the line
+        // both come down to one offset.
+        const double runOffset = (2 - thickness) / 2.;
+        minorOrigin = qRound64((minor1 - major1 * slope + runOffset) * lineFixedOne);
+        minorStep = qRound64(slope * lineFixedOne);
+        minorLow = qRound64((std::min(minor1, minor2) + runOffset) * lineFixedOne);
+        minorHigh = qRound64((std::max(minor1, minor2) + runOffset) * lineFixedOne);
+        zOrigin = p1.z - major1 * zSlope - depthBias;
+        zStep = zSlope;
+        zNear = std::min(p1.z, p2.z) - depthBias;
+        zFar = std::max(p1.z, p2.z) - depthBias;
+    }
+
+    int runStart(qint64 minor) const { return static_cast<int>(std::min(std::max(minor, minorLow), minorHigh) >> 32); }
+    // Depth is worked out per step rather than accumulated, for the same
+    // reason, at the cost of one multiply-add.
+    float zAt(int major) const { return static_cast<float>(std::min(std::max(zOrigin + major * zStep, zNear), zFar)); }
+
+    bool steep;
+    int from, to;
+    int thickness;
+    qint64 minorOrigin, minorStep, minorLow, minorHigh;
+    double zOrigin, zStep, zNear, zFar;
+};
+
+}
+
+template<class Depth>
+void Renderer::drawLines(const std::vector<quint32>& lines, const QColor& color, ObjectId id, Tile& tile,
+                         const Depth& format) {
+    const QRgb rgb = color.rgb();
+    const QRect& clip = tile.clip;
+    for (size_t i = 0; i < lines.size(); i += 2) {
+        const Point3D& p1 = vertices[lines[i]];
+        const Point3D& p2 = vertices[lines[i + 1]];
+        if (tile.samples != nullptr) {
+            fillLineSamples(p1, p2, color, tile, format);
+            continue;
+        }
+        const LineSetup line(p1, p2, edgeWidth, edgeDepthBias);
+        const int majorFrom = std::max(line.from, line.steep ? clip.top() : clip.left());
+        const int majorTo = std::min(line.to, line.steep ? clip.bottom() : clip.right());
+        const int minorFrom = line.steep ? clip.left() : clip.top();
+        const int minorTo = line.steep ? clip.right() : clip.bottom();
+        qint64 minor = line.minorOrigin + majorFrom * line.minorStep;
+        for (int major = majorFrom; major <= majorTo; major++, minor += line.minorStep) {
+            const int start = line.runStart(minor);
+            const int runFrom = std::max(start, minorFrom);
+            const int runTo = std::min(start + line.thickness - 1, minorTo);
+            const float z = line.zAt(major);
+            for (int across = runFrom; across <= runTo; across++) {
+                const int x = line.steep ? across : major;
+                const int y = line.steep ? major : across;
+                if (shadePixel(frameBuffer.colors.row(y)[x], frameBuffer.depths.row<typename Depth::Value>(y)[x], z, rgb, 0,
+                               format)) {
+                    hiZ.markWritten(x, y);
+                    tile.stats.fragmentsPassed++;
+                    if (writeObjectIds) {
+                        frameBuffer.objectIds.row(y)[x] = id;
+                    }
+                }
+            }
+            tile.stats.fragmentsTested += std::max(runTo - runFrom + 1, 0);
+        }
+    }
+}
+
+namespace {
+
+// Vertex position in fixed point, 1 / subpixelScale of a pixel per unit.
+struct FixedPoint {
+    explicit FixedPoint(const Point3D& p)
+        : x(qRound64(p.x * subpixelScale))
+        , y(qRound64(p.y * subpixelScale))
+    {
+
+    }
+    qint64 x, y;
+};
+
+// E(x, y) = a * x + b * y + c is positive on the inner side of the edge
+// from p to q when the triangle has positive area, with x and y in fixed
+// point. Pixels exactly on an edge belong to it only if it is a top or a
+// left edge, so triangles sharing an edge never cover a pixel twice.
+struct EdgeFunction {
+    EdgeFunction()
+        : a(0)
+        , b(0)
+        , c(0)
+        , threshold(0)
+    {
+
+    }
+    EdgeFunction(const FixedPoint& p, const FixedPoint& q)
+        : a(p.y - q.y)
+        , b(q.x - p.x)
+        , c(p.x * q.y - p.y * q.x)
+        , threshold(a > 0 || (a == 0 && b > 0) ? 0 : 1)
+    {
+
+    }
+    qint64 at(qint64 x, qint64 y) const { return a * x + b * y + c; }
+    qint64 a, b, c;
+    qint64 threshold;
+};
+
+qint64 floorDiv(qint64 numerator, qint64 denominator) {
+    qint64 quotient = numerator / denominator;
+    if (numerator % denominator != 0 && (numerator < 0) != (denominator < 0)) {
+        quotient--;
+    }
+    return quotient;
+}
+
+qint64 ceilDiv(qint64 numerator, qint64 denominator) {
+    return -floorDiv(-numerator, denominator);
+}
+
+// floorDiv() with a multiplication by inverse, 1 / denominator, in place of
+// the division, which is slow on 64 bits. Fixed-point products stay far
+// below 2^53, so the estimate is off by one at most after truncation and
+// is corrected exactly.
+qint64 floorDiv(qint64 numerator, qint64 denominator, double inverse) {
+    qint64 quotient = static_cast<qint64>(numerator * inverse);
+    if (denominator > 0) {
+        while (quotient * denominator > numerator) {
+            quotient--;
+        }
+        while ((quotient + 1) * denominator <= numerator) {
+            quotient++;
+        }
+    } else {
+        while (quotient * denominator < numerator) {
+            quotient--;
+        }
+        while ((quotient + 1) * denominator >= numerator) {
+            quotient++;
+        }
+    }
+    return quotient;
+}
+
+qint64 ceilDiv(qint64 numerator, qint64 denominator, double inverse) {
+    return -floorDiv(-numerator, denominator, inverse);
+}
+
+// Edge functions and depth plane of a triangle, wound so that its inside
+// is where all three edge functions are positive.
+struct TriangleSetup {
+    TriangleSetup(const Point3D& p1, const Point3D& p2, const Point3D& p3)
+        : f0(p1)
+        , g1(p2)
+        , g2(p3)
+        , area(EdgeFunction(f0, g1).at(g2.x, g2.y))
+        , dzdx(0)
+        , dzdy(0)
+        , zOrigin(0)
+    {
+        if (area < 0) {
+            std::swap(g1, g2);
+        }
+        if (area == 0) {
+            return;
+        }
+        const Point3D& v0 = p1;
+        const Point3D& v1 = area > 0 ? p2 : p3;
+        const Point3D& v2 = area > 0 ? p3 : p2;
+        edges[0] = EdgeFunction(g1, g2);
+        edges[1] = EdgeFunction(g2, f0);
+        edges[2] = EdgeFunction(f0, g1);
+        for (int i = 0; i < 3; i++) {
+            inverseSteps[i] = edges[i].a != 0 ? 1. / (edges[i].a * subpixelScale) : 0;
+        }
+        const double doubleArea = std::abs(area);
+
+        // Depth is affine in screen space, so it is interpolated exactly by
+        // stepping the plane equation z(x, y) = z0 + dzdx * x + dzdy * y,
+        // with x and y in pixels.
+        dzdx = ((v1.z - v0.z) * edges[1].a + (v2.z - v0.z) * edges[2].a) * subpixelScale / doubleArea;
+        dzdy = ((v1.z - v0.z) * edges[1].b + (v2.z - v0.z) * edges[2].b) * subpixelScale / doubleArea;
+        zOrigin = v0.z - (dzdx * f0.x + dzdy * f0.y) / subpixelScale;
+    }
+
+    // Pixels whose sample point at (x + offsetX, y + offsetY), in fixed
+    // point, lies inside, narrowed down from [fromX, toX].
+    void span(int y, qint64 offsetX, qint64 offsetY, qint64& fromX, qint64& toX) const {
+        for (int i = 0; i < 3; i++) {
+            const EdgeFunction& edge = edges[i];
+            narrow(i, edge.b * (y * subpixelScale + offsetY) + edge.a * offsetX + edge.c, fromX, toX);
+        }
+    }
+    // Pixels with any point inside that lies within reach of their sample
+    // point along both axes, in fixed point, narrowed down from
+    // [fromX, toX]: what any sample pattern of that reach can cover.
+    void reachSpan(int y, qint64 reach, qint64& fromX, qint64& toX) const {
+        for (int i = 0; i < 3; i++) {
+            const EdgeFunction& edge = edges[i];
+            narrow(i, edge.b * y * subpixelScale + edge.c + (std::abs(edge.a) + std::abs(edge.b)) * reach, fromX, toX);
+        }
+    }
+
+    qint64 top() const { return std::min({f0.y, g1.y, g2.y}); }
+    qint64 bottom() const { return std::max({f0.y, g1.y, g2.y}); }
+    qint64 left() const { return std::min({f0.x, g1.x, g2.x}); }
+    qint64 right() const { return std::max({f0.x, g1.x, g2.x}); }
+
+    // Narrows [fromX, toX] down to where edge i, with rowValue the part of
+    // it that does not depend on x, is at least its threshold.
+    void narrow(int i, qint64 rowValue, qint64& fromX, qint64& toX) const {
+        // Solve a * x * subpixelScale + rowValue >= threshold for x.
+        const EdgeFunction& edge = edges[i];
+        const qint64 step = edge.a * subpixelScale;
+        if (edge.a > 0) {
+            fromX = std::max(fromX, ceilDiv(edge.threshold - rowValue, step, inverseSteps[i]));
+        } else if (edge.a < 0) {
+            toX = std::min(toX, floorDiv(edge.threshold - rowValue, step, inverseSteps[i]));
+        } else if (rowValue < edge.threshold) {
+            toX = fromX - 1;
+        }
+    }
+
+    FixedPoint f0, g1, g2;
+    qint64 area;
+    EdgeFunction edges[3];
+    // 1 / (a * subpixelScale) of every edge, 0 for horizontal ones.
+    double inverseSteps[3];
+    double dzdx, dzdy, zOrigin;
+};
+
+qint64 cross(const FixedPoint& a, const FixedPoint& b, const FixedPoint& c) {
+    return (b.x - a.x) * (c.y - b.y) - (b.y - a.y) * (c.x - b.x);
+}
+
+// Outline of a polygon with any number of vertices, in fixed point with
+// the depth of every vertex, and the shape facts that decide how it is
+// filled.
+struct PolygonSetup {
+    PolygonSetup(const std::vector<Point3D>& vertices, const quint32* indices, int count,
+                 std::vector<FixedPoint>& outline, std::vector<double>& outlineZ)
+        : points(outline)
+        , depths(outlineZ)
+        , area(0)
+        , convex(true)
+        , planar(false)
+    {
+        points.clear();
+        depths.clear();
+        for (int i = 0; i < count; i++) {
+            points.push_back(FixedPoint(vertices[indices[i]]));
+            depths.push_back(vertices[indices[i]].z);
+        }
+        int turns = 0;
+        for (int i = 0; i < count; i++) {
+            const FixedPoint& p = points[i];
+            const FixedPoint& q = points[(i + 1) % count];
+            area += p.x * q.y - p.y * q.x;
+            const qint64 turn = cross(p, q, points[(i + 2) % count]);
+            turns |= (turn > 0 ? 1 : 0) | (turn < 0 ? 2 : 0);
+        }
+        convex = turns != 3;
+        if (area == 0) {
+            return;
+        }
+
+        // Newell's method: the normal of the plane through all vertices,
+        // in the least squares sense for ones that are not quite planar.
+        double nx = 0, ny = 0, nz = 0, sumX = 0, sumY = 0, sumZ = 0;
+        for (int i = 0; i < count; i++) {
+            const double x = static_cast<double>(points[i].x) / subpixelScale;
+            const double y = static_cast<double>(points[i].y) / subpixelScale;
+            const double z = depths[i];
+            const int j = (i + 1) % count;
+            const double nextX = static_cast<double>(points[j].x) / subpixelScale;
+            const double nextY = static_cast<double>(points[j].y) / subpixelScale;
+            const double nextZ = depths[j];
+            nx += (y - nextY) * (z + nextZ);
+            ny += (z - nextZ) * (x + nextX);
+            nz += (x - nextX) * (y + nextY);
+            sumX += x;
+            sumY += y;
+            sumZ += z;
+        }
+        const double dzdx = -nx / nz;
+        const double dzdy = -ny / nz;
+        const double zOrigin = (sumZ - dzdx * sumX - dzdy * sumY) / count;
+        double deviation = 0, extent = 0;
+        for (int i = 0; i < count; i++) {
+            const double planeZ = zOrigin + (dzdx * points[i].x + dzdy * points[i].y) / subpixelScale;
+            deviation = std::max(deviation, std::abs(depths[i] - planeZ));
+            extent = std::max(extent, std::abs(depths[i]));
+        }
+        planar = deviation <= planarTolerance * (extent + 1);
+    }
+
+    std::vector<FixedPoint>& points;
+    std::vector<double>& depths;
+    // Twice the signed area, in fixed point squared.
+    qint64 area;
+    bool convex, planar;
+};
+
+// A polygon edge that is not horizontal, stepped from its upper end down
+// one pixel row at a time without divisions. It crosses the current row at
+// x - remainder / denominator pixels, so x is the first pixel whose sample
+// point lies on or right of it.
+struct ScanEdge {
+    ScanEdge(const FixedPoint& upper, const FixedPoint& lower, double upperZ, double lowerZ, int fromRow, int toRow)
+        : firstRow(fromRow)
+        , lastRow(toRow)
+        , denominator((lower.y - upper.y) * subpixelScale)
+        , topY(upper.y)
+        , topZ(upperZ)
+        , dzdy((lowerZ - upperZ) / (lower.y - upper.y))
+    {
+        const qint64 dx = lower.x - upper.x;
+        const qint64 dy = lower.y - upper.y;
+        const qint64 crossing = upper.x * dy + (static_cast<qint64>(firstRow) * subpixelScale - upper.y) * dx;
+        const qint64 first = ceilDiv(crossing, denominator);
+        x = static_cast<int>(first);
+        remainder = first * denominator - crossing;
+        stepX = static_cast<int>(floorDiv(dx, dy));
+        stepRemainder = dx * subpixelScale - stepX * denominator;
+    }
+    double crossing() const { return x - static_cast<double>(remainder) / denominator; }
+    // Depth where the edge crosses row, worked out from its upper end
+    // rather than stepped, so scissored redraws reproduce the depths of
+    // full ones exactly.
+    double zAt(int row) const { return topZ + (static_cast<qint64>(row) * subpixelScale - topY) * dzdy; }
+    void step() {
+        x += stepX;
+        remainder -= stepRemainder;
+        if (remainder < 0) {
+            x++;
+            remainder += denominator;
+        }
+    }
+
+    int firstRow, lastRow;
+    int x;
+    qint64 remainder, denominator;
+    int stepX;
+    qint64 stepRemainder;
+    qint64 topY;
+    double topZ;
+    // Per fixed-point unit.
+    double dzdy;
+};
+
+// Edge table and active edge list of a polygon within the rows of a clip.
+// Rows cover [top, bottom) of an edge, so of two edges meeting at a vertex
+// exactly one crosses its row, and pixels on the outline belong to the
+// polygon on its left and top sides only, as they do for triangles.
+class ScanConverter {
+public:
+    ScanConverter(const std::vector<FixedPoint>& points, const std::vector<double>& depths, const QRect& clip,
+                  std::vector<ScanEdge>& edgeTable, std::vector<ScanEdge*>& activeEdges)
+        : edges(edgeTable)
+        , active(activeEdges)
+        , next(0)
+    {
+        edges.clear();
+        active.clear();
+        const int count = static_cast<int>(points.size());
+        for (int i = 0; i < count; i++) {
+            const int j = (i + 1) % count;
+            if (points[i].y == points[j].y) {
+                continue;
+            }
+            const int upperIndex = points[i].y < points[j].y ? i : j;
+            const int lowerIndex = upperIndex == i ? j : i;
+            const FixedPoint& upper = points[upperIndex];
+            const FixedPoint& lower = points[lowerIndex];
+            const int fromRow = std::max(static_cast<int>(ceilDiv(upper.y, subpixelScale)), clip.top());
+            const int toRow = std::min(static_cast<int>(ceilDiv(lower.y, subpixelScale)) - 1, clip.bottom());
+            if (fromRow <= toRow) {
+                edges.push_back(ScanEdge(upper, lower, depths[upperIndex], depths[lowerIndex], fromRow, toRow));
+            }
+        }
+        std::sort(edges.begin(), edges.end(), [] (const ScanEdge& a, const ScanEdge& b) {
+            return a.firstRow < b.firstRow;
+        });
+        row = edges.empty() ? clip.bottom() + 1 : edges.front().firstRow;
+    }
+
+    bool atEnd() const { return active.empty() && next == edges.size(); }
+    // Row the active edges cross, sorted by x; pairs of them bound the
+    // spans inside.
+    int currentRow() const { return row; }
+    const std::vector<ScanEdge*>& crossings() const { return active; }
+    // Sets up the active edges of the next row that has any.
+    void advance() {
+        if (active.empty() && next < edges.size()) {
+            row = edges[next].firstRow;
+        }
+        while (next < edges.size() && edges[next].firstRow <= row) {
+            active.push_back(&edges[next++]);
+        }
+        // Edges hardly ever change places between rows, so insertion sort
+        // runs in linear time.
+        for (size_t i = 1; i < active.size(); i++) {
+            ScanEdge* edge = active[i];
+            size_t j = i;
+            for (; j > 0 && active[j - 1]->x > edge->x; j--) {
+                active[j] = active[j - 1];
+            }
+            active[j] = edge;
+        }
+    }
+    // Steps the active edges down a row and drops the ones that end.
+    void step() {
+        row++;
+        size_t kept = 0;
+        for (ScanEdge* edge : active) {
+            if (edge->lastRow >= row) {
+                edge->step();
+                active[kept++] = edge;
+            }
+        }
+        active.resize(kept);
+    }
+
+private:
+    std::vector<ScanEdge>& edges;
+    std::vector<ScanEdge*>& active;
+    size_t next;
+    int row;
+};
+
+// Splits a simple polygon into triangles by clipping ears off it, for the
+// ones that are concave and cannot be drawn as a fan. Appends triples of
+// indices into points to triangles.
+void triangulate(const std::vector<FixedPoint>& points, qint64 area, std::vector<int>& remaining,
+                 std::vector<int>& triangles) {
+    const auto inward = [area] (qint64 turn) { return area > 0 ? turn > 0 : turn < 0; };
+    const auto outward = [area] (qint64 turn) { return area > 0 ? turn < 0 : turn > 0; };
+    remaining.clear();
+    for (int i = 0; i < static_cast<int>(points.size()); i++) {
+        remaining.push_back(i);
+    }
+    int i = 0;
+    int tries = 0;
+    while (remaining.size() > 3 && tries < static_cast<int>(remaining.size())) {
+        const int count = static_cast<int>(remaining.size());
+        const int a = remaining[(i + count - 1) % count], b = remaining[i], c = remaining[(i + 1) % count];
+        bool ear = inward(cross(points[a], points[b], points[c]));
+        for (int k = 0; ear && k < count; k++) {
+            const int p = remaining[k];
+            if (p == a || p == b || p == c) {
+                continue;
+            }
+            ear = outward(cross(points[a], points[b], points[p])) || outward(cross(points[b], points[c], points[p]))
+                || outward(cross(points[c], points[a], points[p]));
+        }
+        if (!ear) {
+            i = (i + 1) % count;
+            tries++;
+            continue;
+        }
+        triangles.insert(triangles.end(), {a, b, c});
+        remaining.erase(remaining.begin() + i);
+        i %= count - 1;
+        tries = 0;
+    }
+    // What is left is a triangle, or degenerate enough that no ear was
+    // found and a fan does as well as anything.
+    for (size_t k = 2; k < remaining.size(); k++) {
+        triangles.insert(triangles.end(), {remaining[0], remaining[k - 1], remaining[k]});
+    }
+}
+
+// Scratch space of the polygon a worker is filling.
+struct PolygonScratch {
+    std::vector<FixedPoint> points;
+    std::vector<double> depths;
+    std::vector<ScanEdge> edges;
+    std::vector<ScanEdge*> activeEdges;
+    std::vector<int> remaining;
+    std::vector<int> triangles;
+};
+
+PolygonScratch& workerPolygonScratch() {
+    thread_local PolygonScratch scratch;
+    return scratch;
+}
+
+}
+
+template<class Depth>
+void Renderer::fillTriangle(const Point3D& p1, const Point3D& p2, const Point3D& p3, const QColor& color, ObjectId id,
+                            Tile& tile, const Depth& format) {
+    if (tile.samples != nullptr) {
+        fillTriangleSamples(p1, p2, p3, color, colorCoeff, tile, format);
+        return;
+    }
+    const QRect& clip = tile.clip;
+    const TriangleSetup triangle(p1, p2, p3);
+    if (triangle.area == 0) {
+        return;
+    }
+    const double dzdx = triangle.dzdx;
+    const double dzdy = triangle.dzdy;
+
+    // Pixels are sampled at whole coordinates.
+    const int fromY = std::max(static_cast<int>(ceilDiv(triangle.top(), subpixelScale)), clip.top());
+    const int toY = std::min(static_cast<int>(floorDiv(triangle.bottom(), subpixelScale)), clip.bottom());
+    const int minX = std::max(static_cast<int>(ceilDiv(triangle.left(), subpixelScale)), clip.left());
+    const int maxX = std::min(static_cast<int>(floorDiv(triangle.right(), subpixelScale)), clip.right());
+    const QRgb rgb = color.rgb();
+
+    for (int y = fromY; y <= toY; y++) {
+        qint64 fromX = minX, toX = maxX;
+        triangle.span(y, 0, 0, fromX, toX);
+        if (fromX > toX) {
+            continue;
+        }
+        const int count = static_cast<int>(toX - fromX + 1);
+        const int column = static_cast<int>(fromX);
+        const double z0 = triangle.zOrigin + dzdx * column + dzdy * y;
+        if (hiZ.occludesSpan(y, column, column + count - 1,
+                             depthKey(format, nearestBound(std::min(z0, z0 + dzdx * (count - 1)))))) {
+            tile.stats.fragmentsCulled += count;
+            continue;
+        }
+        uint8_t* ids = objectIdRow(y);
+        const int passed = shadeSpan(frameBuffer.colors.row(y) + column,
+                                     frameBuffer.depths.row<typename Depth::Value>(y) + column, format, count,
+                                     z0, dzdx, rgb, colorCoeff, ids != nullptr ? ids + column : nullptr, id);
+        if (passed > 0) {
+            hiZ.markWritten(y, column, column + count - 1);
+        }
+        tile.stats.fragmentsTested += count;
+        tile.stats.fragmentsPassed += passed;
+    }
+}
+
+template<class Depth>
+void Renderer::fillPolygon(const quint32* indices, int count, const QColor& color, ObjectId id, Tile& tile,
+                           const Depth& format) {
+    if (count == 3) {
+        fillTriangle(vertices[indices[0]], vertices[indices[1]], vertices[indices[2]], color, id, tile, format);
+        return;
+    }
+    PolygonScratch& scratch = workerPolygonScratch();
+    const PolygonSetup polygon(vertices, indices, count, scratch.points, scratch.depths);
+    if (polygon.area == 0) {
+        return;
+    }
+    // Multisampled or bent polygons go through triangles: a fan when it
+    // covers the polygon exactly, ears otherwise.
+    if (tile.samples != nullptr || !polygon.planar) {
+        if (polygon.convex) {
+            for (int i = 2; i < count; i++) {
+                fillTriangle(vertices[indices[0]], vertices[indices[i - 1]], vertices[indices[i]], color, id, tile,
+                             format);
+            }
+            return;
+        }
+        scratch.triangles.clear();
+        triangulate(scratch.points, polygon.area, scratch.remaining, scratch.triangles);
+        for (size_t i = 0; i < scratch.triangles.size(); i += 3) {
+            fillTriangle(vertices[indices[scratch.triangles[i]]], vertices[indices[scratch.triangles[i + 1]]],
+                         vertices[indices[scratch.triangles[i + 2]]], color, id, tile, format);
+        }
+        return;
+    }
+
+    // Depth is interpolated along the edges and then across each span,
+    // which keeps it exact on the outline, where the mesh edges are drawn,
+    // even though snapping leaves the vertices a little off one plane.
+    const QRect& clip = tile.clip;
+    const QRgb rgb = color.rgb();
+    ScanConverter scan(scratch.points, scratch.depths, clip, scratch.edges, scratch.activeEdges);
+    for (; !scan.atEnd(); scan.step()) {
+        scan.advance();
+        const int y = scan.currentRow();
+        const std::vector<ScanEdge*>& crossings = scan.crossings();
+        // Even-odd: pixels between the first and second crossing are inside,
+        // then between the third and fourth, and so on.
+        for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+            const ScanEdge& left = *crossings[i];
+            const ScanEdge& right = *crossings[i + 1];
+            const int fromX = std::max(left.x, clip.left());
+            const int toX = std::min(right.x - 1, clip.right());
+            if (fromX > toX) {
+                continue;
+            }
+            const int spanCount = toX - fromX + 1;
+            const double leftX = left.crossing();
+            const double leftZ = left.zAt(y);
+            const double dzdx = (right.zAt(y) - leftZ) / (right.crossing() - leftX);
+            const double z0 = leftZ + dzdx * (fromX - leftX);
+            if (hiZ.occludesSpan(y, fromX, toX, depthKey(format, nearestBound(std::min(z0, z0 + dzdx * (spanCount - 1)))))) {
+                tile.stats.fragmentsCulled += spanCount;
+                continue;
+            }
+            uint8_t* ids = objectIdRow(y);
+            const int passed = shadeSpan(frameBuffer.colors.row(y) + fromX,
+                                         frameBuffer.depths.row<typename Depth::Value>(y) + fromX, format, spanCount,
+                                         z0, dzdx, rgb, colorCoeff, ids != nullptr ? ids + fromX : nullptr, id);
+            if (passed > 0) {
+                hiZ.markWritten(y, fromX, toX);
+            }
+            tile.stats.fragmentsTested += spanCount;
+            tile.stats.fragmentsPassed += passed;
+        }
+    }
+}
+
+template<class Depth, class SampleZ, class CenterZ>
+void Renderer::writeSampleRow(int y, const SampleSpans& spans, QRgb color, float colorCoeff, Tile& tile,
+                              const Depth& format, SampleZ sampleZ, CenterZ centerZ, const KeyPlane* plane) {
+    const int samples = spans.pattern.count;
+    // Spans lie inside the clip, which is at most a tile wide.
+    unsigned masks[tileSize];
+    float keys[tileSize * SamplePattern::maxCount];
+    float centerZs[tileSize];
+    QRgb shaded[tileSize];
+    float farthestKeys[tileSize];
+    const int count = spans.unionTo - spans.unionFrom + 1;
+    typename Depth::Value* depths = frameBuffer.depths.row<typename Depth::Value>(y) + spans.unionFrom;
+    // Pixels that do not pass get their own depth back below, so the whole
+    // row can be written back without branches.
+    for (int i = 0; i < count; i++) {
+        farthestKeys[i] = Depth::key(depths[i]);
+    }
+    // The inner run of a planar fragment goes to the sample buffer as its
+    // plane, the rest sample by sample.
+    const int innerFrom = plane != nullptr ? spans.innerFrom - spans.unionFrom : count;
+    const int innerTo = plane != nullptr ? spans.innerTo - spans.unionFrom : count - 1;
+    int tested = std::max(innerTo - innerFrom + 1, 0);
+    for (int i = 0; i < count; i++) {
+        const int x = spans.unionFrom + i;
+        masks[i] = i >= innerFrom && i <= innerTo ? 0 : spans.mask(x);
+        if (masks[i] == 0) {
+            continue;
+        }
+        tested++;
+        for (int s = 0; s < samples; s++) {
+            keys[i * samples + s] = depthKey(format, sampleZ(x, s));
+        }
+    }
+    // Shaded once for the whole pixel, at its sample point.
+    for (int i = 0; i < count; i++) {
+        centerZs[i] = centerZ(spans.unionFrom + i);
+    }
+    shadeColors(shaded, count, centerZs, color, colorCoeff);
+    QRgb* colors = frameBuffer.colors.row(y) + spans.unionFrom;
+    int passed = tile.samples->writeRow(y, spans.unionFrom, count, masks, keys, shaded, colors, farthestKeys);
+    if (innerFrom <= innerTo) {
+        passed += tile.samples->writePlaneRow(y, spans.unionFrom + innerFrom, innerTo - innerFrom + 1,
+                                              static_cast<float>(plane->rowKey + plane->slopeX * (spans.unionFrom + innerFrom)),
+                                              plane->slopeX, plane->slopeY, shaded + innerFrom, colors + innerFrom,
+                                              farthestKeys + innerFrom);
+    }
+    if (passed > 0) {
+        for (int i = 0; i < count; i++) {
+            depths[i] = Depth::fromKey(farthestKeys[i]);
+        }
+        hiZ.markWritten(y, spans.unionFrom, spans.unionTo);
+    }
+    tile.stats.fragmentsTested += tested;
+    tile.stats.fragmentsPassed += passed;
+}
+
+template<class Depth>
+void Renderer::fillTriangleSamples(const Point3D& p1, const Point3D& p2, const Point3D& p3, const QColor& color,
+                                   float colorCoeff, Tile& tile, const Depth& format) {
+    const QRect& clip = tile.clip;
+    const TriangleSetup triangle(p1, p2, p3);
+    if (triangle.area == 0) {
+        return;
+    }
+    const SamplePattern& pattern = tile.samples->pattern();
+    // Offsets are in 1/16 of a pixel.
+    const int offsetShift = subpixelBits - 4;
+    const double dzdx = triangle.dzdx;
+    const double dzdy = triangle.dzdy;
+    // Farthest any sample of a pixel gets from the depth at its sample point.
+    const double zReach = (std::abs(dzdx) + std::abs(dzdy)) / 2;
+
+    // Samples lie within half a pixel of the sample point, so one more row
+    // and column on every side is enough.
+    const int fromY = std::max(static_cast<int>(ceilDiv(triangle.top(), subpixelScale)) - 1, clip.top());
+    const int toY = std::min(static_cast<int>(floorDiv(triangle.bottom(), subpixelScale)) + 1, clip.bottom());
+    const int minX = std::max(static_cast<int>(ceilDiv(triangle.left(), subpixelScale)) - 1, clip.left());
+    const int maxX = std::min(static_cast<int>(floorDiv(triangle.right(), subpixelScale)) + 1, clip.right());
+    const QRgb rgb = color.rgb();
+    // Depth of every sample relative to the sample point of its pixel.
+    double sampleDz[SamplePattern::maxCount];
+    for (int s = 0; s < pattern.count; s++) {
+        sampleDz[s] = dzdx * pattern.offsetX[s] + dzdy * pattern.offsetY[s];
+    }
+    const float keySlopeX = static_cast<float>(dzdx * format.keyScale());
+    const float keySlopeY = static_cast<float>(dzdy * format.keyScale());
+
+    for (int y = fromY; y <= toY; y++) {
+        // Rows and runs no sample reaches are dropped before the spans of
+        // the samples are worked out one by one.
+        qint64 reachFromX = minX, reachToX = maxX;
+        triangle.reachSpan(y, subpixelScale / 2, reachFromX, reachToX);
+        if (reachFromX > reachToX) {
+            continue;
+        }
+        const double rowZ = triangle.zOrigin + dzdy * y;
+        const double z0 = rowZ + dzdx * reachFromX;
+        const double z1 = rowZ + dzdx * reachToX;
+        if (hiZ.occludesSpan(y, static_cast<int>(reachFromX), static_cast<int>(reachToX),
+                             depthKey(format, nearestBound(std::min(z0, z1) - zReach)))) {
+            tile.stats.fragmentsCulled += reachToX - reachFromX + 1;
+            continue;
+        }
+        SampleSpans spans(pattern, clip);
+        for (int s = 0; s < pattern.count; s++) {
+            qint64 fromX = reachFromX, toX = reachToX;
+            triangle.span(y, static_cast<qint64>(pattern.x[s]) << offsetShift,
+                          static_cast<qint64>(pattern.y[s]) << offsetShift, fromX, toX);
+            spans.add(s, static_cast<int>(fromX), static_cast<int>(toX));
+        }
+        if (spans.isEmpty()) {
+            continue;
+        }
+        // Where depth is linear in the key too, without clamping, the keys
+        // of the row lie in a plane.
+        const double nearestZ = std::min(z0, z1) - zReach;
+        const double farthestZ = std::max(z0, z1) + zReach;
+        const float nearestKey = std::min(format.linearKey(nearestZ), format.linearKey(farthestZ));
+        const float farthestKey = std::max(format.linearKey(nearestZ), format.linearKey(farthestZ));
+        const KeyPlane plane = {format.linearKey(0) + rowZ * format.keyScale(), keySlopeX, keySlopeY};
+        const bool planar = nearestKey >= Depth::nearestKey() && farthestKey <= Depth::key(Depth::farthest());
+        writeSampleRow(y, spans, rgb, colorCoeff, tile, format,
+                       [&] (int x, int s) { return static_cast<float>(rowZ + dzdx * x + sampleDz[s]); },
+                       [&] (int x) { return static_cast<float>(rowZ + dzdx * x); }, planar ? &plane : nullptr);
+    }
+}
+
+template<class Depth>
+void Renderer::fillSphereSamples(const Sphere& sphere, const QColor& color, Tile& tile, const Depth& format) {
+    const QRect& clip = tile.clip;
+    const SamplePattern& pattern = tile.samples->pattern();
+    const float centerX = sphere.center.x();
+    const float centerY = sphere.center.y();
+    const float centerZ = sphere.center.z();
+    const float radius = sphere.radius;
+    const int fromY = std::max(static_cast<int>(std::ceil(centerY - radius)) - 1, clip.top());
+    const int toY = std::min(static_cast<int>(std::floor(centerY + radius)) + 1, clip.bottom());
+    const QRgb rgb = color.rgb();
+    float rowQ[SamplePattern::maxCount];
+    for (int y = fromY; y <= toY; y++) {
+        SampleSpans spans(pattern, clip);
+        float deepestQ = 0;
+        for (int s = 0; s < pattern.count; s++) {
+            const float dy = y + pattern.offsetY[s] - centerY;
+            rowQ[s] = radius * radius - dy * dy;
+            if (rowQ[s] < 0) {
+                spans.add(s, clip.right() + 1, clip.left() - 1);
+                continue;
+            }
+            const double halfWidth = std::sqrt(static_cast<double>(rowQ[s]));
+            const int fromX = static_cast<int>(std::ceil(centerX - pattern.offsetX[s] - halfWidth));
+            const int toX = static_cast<int>(std::floor(centerX - pattern.offsetX[s] + halfWidth));
+            spans.add(s, std::max(fromX, clip.left()), std::min(toX, clip.right()));
+            deepestQ = std::max(deepestQ, rowQ[s]);
+        }
+        if (spans.isEmpty()) {
+            continue;
+        }
+        if (hiZ.occludesSpan(y, spans.unionFrom, spans.unionTo, depthKey(format, sphereZ(0, deepestQ, centerZ, sphereDepthScale)))) {
+            tile.stats.fragmentsCulled += spans.unionTo - spans.unionFrom + 1;
+            continue;
+        }
+        const float dy = y - centerY;
+        const float centerQ = radius * radius - dy * dy;
+        writeSampleRow(y, spans, rgb, colorCoeff, tile, format,
+                       [&] (int x, int s) {
+                           return sphereZ(x + pattern.offsetX[s] - centerX, rowQ[s], centerZ, sphereDepthScale);
+                       },
+                       [&] (int x) { return sphereZ(x - centerX, centerQ, centerZ, sphereDepthScale); }, nullptr);
+    }
+}
+
+template<class Depth>
+void Renderer::fillLineSamples(const Point3D& p1, const Point3D& p2, const QColor& color, Tile& tile,
+                               const Depth& format) {
+    // A quad edgeWidth pixels wide around the segment, at the biased depth
+    // of the segment all across.
+    const double dx = p2.x - p1.x;
+    const double dy = p2.y - p1.y;
+    const double length = std::sqrt(dx * dx + dy * dy);
+    const double z1 = p1.z - edgeDepthBias;
+    const double z2 = p2.z - edgeDepthBias;
+    if (length == 0) {
+        // A point, which the single-sampled walker draws as well: a square
+        // edgeWidth on a side around it.
+        const float half = edgeWidth / 2;
+        const Point3D a(p1.x - half, p1.y - half, z1), b(p1.x + half, p1.y - half, z1);
+        const Point3D c(p1.x + half, p1.y + half, z1), d(p1.x - half, p1.y + half, z1);
+        fillTriangleSamples(a, b, c, color, 0, tile, format);
+        fillTriangleSamples(a, c, d, color, 0, tile, format);
+        return;
+    }
+    const float nx = static_cast<float>(-dy / length * edgeWidth / 2);
+    const float ny = static_cast<float>(dx / length * edgeWidth / 2);
+    const Point3D a(p1.x + nx, p1.y + ny, z1), b(p1.x - nx, p1.y - ny, z1);
+    const Point3D c(p2.x - nx, p2.y - ny, z2), d(p2.x + nx, p2.y + ny, z2);
+    fillTriangleSamples(a, b, c, color, 0, tile, format);
+    fillTriangleSamples(a, c, d, color, 0, tile, format);
+}
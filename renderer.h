@@ -0,0 +1,203 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <QColor>
+#include <QRect>
+#include <vector>
+#include "point3d.h"
+#include "framebuffer.h"
+#include "hizbuffer.h"
+#include "renderstats.h"
+#include "samplebuffer.h"
+#include "scene.h"
+#include "vertexstage.h"
+
+// Z-buffer rasterizer for a mesh and any number of spheres. Draws into its own
+// FrameBuffer and has no dependency on a widget or a display.
+//
+// Mesh vertices go through the scene's transform once per frame, into
+// clip space. Primitives entirely outside the view are dropped there, and
+// the ones crossing the near plane or reaching far beyond the frame are
+// clipped. The rest is rasterized with vertex positions in fixed point at
+// 1/256 of a pixel. Edges are walked pixel by pixel along their major
+// axis with integer steps; the ones of a tile are drawn together as a list.
+//
+// Faces with more than three corners are scan converted whole through an
+// edge table and a list of active edges, concave or not, as long as they
+// are planar. Bent faces, and all faces when multisampling, are split into
+// triangles instead: a fan where that covers them exactly, ears otherwise.
+//
+// The target is split into square tiles. Every primitive of a frame is
+// binned into the tiles its screen bounds overlap, and the tiles are then
+// rasterized in parallel on the global thread pool. A tile is only ever
+// touched by the one worker that owns it, so depth testing needs no locks
+// and primitives inside a tile keep their submission order.
+//
+// Tiles are cleared as they are redrawn, except ones that nothing was drawn
+// into since their last clear; background mostly stays background from one
+// frame to the next.
+//
+// With more than one sample per pixel in the scene, tiles are drawn
+// multisampled into a SampleBuffer and resolved into the color plane when
+// they are done. Edges become quads as wide as the scene's edges then.
+// The depth plane holds the farthest sample of every pixel, which is what
+// the coarse depth level needs.
+//
+// The depth plane is kept in the scene's depth format. Everything from the
+// tile loop down is instantiated once per format, so the depth test is
+// specialized at compile time.
+//
+// Primitives are grouped into objects, the mesh and the spheres, and objects
+// are drawn front-to-back by their nearest depth. Each tile keeps a coarse
+// depth level up to date while it draws. An object or a primitive whose
+// nearest depth lies behind everything already stored under its bounds is
+// skipped for the tile, and the same test drops hidden spans of faces and
+// of spheres before they reach the kernel.
+class Renderer {
+public:
+    enum ObjectId { NoObject, MeshObject, SphereObject };
+
+    Renderer(int width, int height);
+
+    // Changes the size of the target. Buffers are only reallocated when
+    // they grow past every earlier size, and the next render() redraws
+    // the whole frame whatever its scissor.
+    void resize(int width, int height);
+    void render(const Scene& scene) { render(scene, QRect(0, 0, frameBuffer.width(), frameBuffer.height())); }
+    // Clears and redraws only the pixels inside scissor and leaves the rest
+    // of the previous frame in place.
+    void render(const Scene& scene, const QRect& scissor);
+    // Screen rectangle the mesh of scene covers once drawn, or a larger
+    // one: what the corners of its bounding box span.
+    static QRect meshBounds(const Scene& scene);
+    // The same for a mesh inside the model-space box from boxMin to
+    // boxMax, without going over its vertices; for callers that keep the
+    // box of a mesh around.
+    static QRect meshBounds(const Scene& scene, const QVector3D& boxMin, const QVector3D& boxMax);
+    const FrameBuffer& frame() const { return frameBuffer; }
+    // Front-most object of scene at a pixel. Redraws just that pixel with
+    // object ids enabled, so regular frames never write the id plane, and
+    // sorts and projects only the primitives that may reach it.
+    ObjectId pick(const Scene& scene, int x, int y);
+    // Objects of the last frame that were on screen but hidden in every
+    // tile they touched.
+    int culledObjectCount() const { return frameStats.culledObjects; }
+    int objectCount() const { return static_cast<int>(objects.size()); }
+    // Counters of the last render() call. Stage times stay zero unless
+    // profiling is on, since timing every tile stage is not free.
+    const RenderStats& stats() const { return frameStats; }
+    void setProfiling(bool enabled) { profiling = enabled; }
+
+private:
+    struct DrawCommand {
+        enum Kind { Edge, Face, Sphere };
+        Kind kind;
+        // Edges and faces are count indices from first on, into the mesh or,
+        // once clipped, into clippedIndices. Spheres index screenSpheres.
+        int first, count;
+        bool clipped;
+        QRect bounds;
+        float nearestZ;
+        int object;
+    };
+    // A contiguous run of commands that is sorted and culled as a whole.
+    struct DrawObject {
+        ObjectId id;
+        int firstCommand, commandCount;
+        QRect bounds;
+        float nearestZ;
+    };
+    struct Tile {
+        QRect rect;
+        // Part of rect the current render() redraws.
+        QRect clip;
+        // Whether all of rect still holds clearedColor and the farthest
+        // depth from an earlier clear, so the next one can be skipped.
+        bool cleared = false;
+        QRgb clearedColor = 0;
+        std::vector<int> commands;
+        std::vector<int> drawnObjects;
+        RenderStats stats;
+        // Samples of the tile while it is drawn multisampled.
+        SampleBuffer* samples = nullptr;
+        // Edges waiting to be drawn together, as pairs of vertex indices.
+        std::vector<quint32> lines;
+    };
+    // Depth keys of a planar fragment along one row: rowKey + x * slopeX
+    // at the sample point of pixel x, and slopeY per row.
+    struct KeyPlane {
+        double rowKey;
+        float slopeX, slopeY;
+    };
+
+    FrameBuffer frameBuffer;
+    HiZBuffer hiZ;
+    ClipVertices clipVertices;
+    std::vector<quint16> outcodes;
+    // Pixels primitives have to reach to be drawn at all this render().
+    QRect cullRect;
+    // Screen positions of the mesh vertices, followed by the ones clipping
+    // created. While picking, only those of primitives near the pixel.
+    std::vector<Point3D> vertices;
+    std::vector<quint32> clippedIndices;
+    std::vector<Sphere> screenSpheres;
+    // Depth of a target pixel of sphere radius.
+    float sphereDepthScale;
+    // Of the scene's edges, for the frame.
+    float edgeWidth, edgeDepthBias;
+    std::vector<DrawCommand> commands;
+    std::vector<DrawCommand> unsortedCommands;
+    std::vector<DrawObject> objects;
+    std::vector<Tile> tiles;
+    int tileColumns;
+    // The frame holds nothing usable, after a resize or a change of depth
+    // format.
+    bool invalid;
+    // Samples per pixel of the frame; picking always takes one.
+    int sampleCount;
+    RenderStats frameStats;
+    bool profiling;
+    bool writeObjectIds;
+    void setUpTiles();
+    void projectVertices(const Scene& scene);
+    void markPickedVertices(const Mesh& mesh);
+    void buildCommands(const Scene& scene);
+    void addPrimitive(DrawCommand::Kind kind, int first, const quint32* indices, int count);
+    const quint32* commandIndices(const DrawCommand& command, const Mesh& mesh) const;
+    void addObject(ObjectId id, int firstCommand);
+    void sortObjects();
+    void binCommands(const QRect& scissor);
+    void renderTile(Tile& tile, const Scene& scene, const QRect& scissor);
+    template<class Depth>
+    void drawTile(Tile& tile, const Scene& scene, const Depth& format);
+    void collectStats();
+    QRect vertexBounds(const quint32* indices, int count, double reach) const;
+    float vertexNearestZ(const quint32* indices, int count) const;
+    uint8_t* objectIdRow(int y) { return writeObjectIds ? frameBuffer.objectIds.row(y) : nullptr; }
+    // Draws the segments between pairs of vertices in lines.
+    template<class Depth>
+    void drawLines(const std::vector<quint32>& lines, const QColor& color, ObjectId id, Tile& tile, const Depth& format);
+    template<class Depth>
+    void fillPolygon(const quint32* indices, int count, const QColor& color, ObjectId id, Tile& tile, const Depth& format);
+    template<class Depth>
+    void fillTriangle(const Point3D& p1, const Point3D& p2, const Point3D& p3, const QColor& color, ObjectId id,
+                      Tile& tile, const Depth& format);
+    template<class Depth>
+    void fillSphere(const Sphere& sphere, const QColor& color, ObjectId id, Tile& tile, const Depth& format);
+    template<class Depth>
+    void fillTriangleSamples(const Point3D& p1, const Point3D& p2, const Point3D& p3, const QColor& color,
+                             float colorCoeff, Tile& tile, const Depth& format);
+    template<class Depth>
+    void fillSphereSamples(const Sphere& sphere, const QColor& color, Tile& tile, const Depth& format);
+    template<class Depth>
+    void fillLineSamples(const Point3D& p1, const Point3D& p2, const QColor& color, Tile& tile, const Depth& format);
+    // Tests and writes the covered samples of every pixel in spans.
+    // sampleZ(x, s) is the depth at sample s of pixel x, centerZ(x) the one
+    // the pixel is shaded with. When the keys of the row lie in plane, the
+    // inner span is written as that plane.
+    template<class Depth, class SampleZ, class CenterZ>
+    void writeSampleRow(int y, const SampleSpans& spans, QRgb color, float colorCoeff, Tile& tile, const Depth& format,
+                        SampleZ sampleZ, CenterZ centerZ, const KeyPlane* plane);
+};
+
+#endif // RENDERER_H
@@ -0,0 +1,53 @@
+#ifndef RENDERSTATS_H
+#define RENDERSTATS_H
+
+#include <QtGlobal>
+
+// Counters of one rendered frame. Stage times are CPU time summed over all
+// tiles, so with several workers they add up to more than the frame took;
+// setupNsecs and rasterNsecs are wall time of the two phases of render().
+// Stage times are only measured while profiling is enabled, fragment
+// counters always are.
+struct RenderStats {
+    enum Stage { Clear, Edges, Faces, Spheres, Resolve, StageCount };
+
+    qint64 setupNsecs = 0;
+    qint64 rasterNsecs = 0;
+    qint64 stageNsecs[StageCount] = {};
+    // Fragments that reached the depth test and the ones that won it.
+    qint64 fragmentsTested = 0;
+    qint64 fragmentsPassed = 0;
+    // Fragments of spans the hierarchical depth buffer dropped untested.
+    qint64 fragmentsCulled = 0;
+    int culledObjects = 0;
+    // Tiles redrawn without a clear, since they held only background.
+    int clearsSkipped = 0;
+    // Edges, faces and spheres dropped whole because they lie outside the
+    // view, and edges and faces cut at the near plane or the guard band.
+    int primitivesOutside = 0;
+    int primitivesClipped = 0;
+    // Size of the target the frame was rendered to.
+    int width = 0;
+    int height = 0;
+    // The target changed size for this frame and was redrawn whole, however
+    // little of the scene changed.
+    bool resized = false;
+
+    qint64 fragmentsRejected() const { return fragmentsTested - fragmentsPassed; }
+    qint64 frameNsecs() const { return setupNsecs + rasterNsecs; }
+    void addTile(const RenderStats& tile) {
+        for (int stage = 0; stage < StageCount; stage++) {
+            stageNsecs[stage] += tile.stageNsecs[stage];
+        }
+        fragmentsTested += tile.fragmentsTested;
+        fragmentsPassed += tile.fragmentsPassed;
+        fragmentsCulled += tile.fragmentsCulled;
+        clearsSkipped += tile.clearsSkipped;
+    }
+    static const char* stageName(int stage) {
+        static const char* const names[StageCount] = {"clear", "edges", "faces", "spheres", "resolve"};
+        return names[stage];
+    }
+};
+
+#endif // RENDERSTATS_H
@@ -0,0 +1,125 @@
+#include "renderthread.h"
+#include "frameprofiler.h"
+
+#include <QMutexLocker>
+
+// One buffer being drawn, one finished and one on screen.
+const int bufferCount = 3;
+
+RenderThread::RenderThread(int width, int height, QObject *parent)
+    : QThread(parent)
+    , frameSize(width, height)
+    , sceneDirty(false)
+    , quitting(false)
+    , droppedScenes(0)
+    , profiling(false)
+    , profiler(nullptr)
+    , latest(-1)
+    , presented(-1)
+{
+    const QRect frameRect(0, 0, width, height);
+    buffers.resize(bufferCount);
+    for (auto&& buffer : buffers) {
+        buffer.renderer.reset(new Renderer(width, height));
+        buffer.damage = frameRect;
+    }
+}
+
+RenderThread::~RenderThread() {
+    {
+        QMutexLocker locker(&mutex);
+        quitting = true;
+        sceneChanged.wakeOne();
+    }
+    wait();
+}
+
+void RenderThread::submit(const Scene& newScene, const QRect& damage, const QSize& size) {
+    QMutexLocker locker(&mutex);
+    if (sceneDirty) {
+        droppedScenes++;
+    }
+    scene = newScene;
+    frameSize = size;
+    for (auto&& buffer : buffers) {
+        buffer.damage |= damage;
+    }
+    sceneDirty = true;
+    sceneChanged.wakeOne();
+}
+
+const FrameBuffer* RenderThread::acquireFrame() {
+    QMutexLocker locker(&mutex);
+    presented = latest;
+    return latest < 0 ? nullptr : &buffers[latest].renderer->frame();
+}
+
+void RenderThread::releaseFrame() {
+    QMutexLocker locker(&mutex);
+    presented = -1;
+}
+
+int RenderThread::droppedSceneCount() const {
+    QMutexLocker locker(&mutex);
+    return droppedScenes;
+}
+
+RenderStats RenderThread::frameStats() const {
+    QMutexLocker locker(&mutex);
+    return latestStats;
+}
+
+void RenderThread::setProfiling(bool enabled, FrameProfiler *newProfiler) {
+    QMutexLocker locker(&mutex);
+    profiling = enabled;
+    profiler = newProfiler;
+}
+
+int RenderThread::pickTarget() const {
+    for (int i = 0; i < bufferCount; i++) {
+        if (i != latest && i != presented) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void RenderThread::run() {
+    QMutexLocker locker(&mutex);
+    for (;;) {
+        while (!sceneDirty && !quitting) {
+            sceneChanged.wait(&mutex);
+        }
+        if (quitting) {
+            return;
+        }
+        const int target = pickTarget();
+        const Scene snapshot = scene;
+        const QSize size = frameSize;
+        QRect damage = buffers[target].damage;
+        buffers[target].damage = QRect();
+        sceneDirty = false;
+        Renderer& renderer = *buffers[target].renderer;
+        renderer.setProfiling(profiling);
+        FrameProfiler *frameProfiler = profiler;
+
+        locker.unlock();
+        // The target is neither finished nor on screen, so it can change
+        // size without the lock.
+        const bool resized = renderer.frame().width() != size.width() || renderer.frame().height() != size.height();
+        if (resized) {
+            renderer.resize(size.width(), size.height());
+            damage = QRect(QPoint(0, 0), size);
+        }
+        renderer.render(snapshot, damage);
+        if (frameProfiler != nullptr) {
+            frameProfiler->recordFrame(renderer.stats());
+        }
+        locker.relock();
+
+        latest = target;
+        latestStats = renderer.stats();
+        latestStats.resized = resized;
+        emit frameReady(damage);
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef RENDERTHREAD_H
+#define RENDERTHREAD_H
+
+#include <QMutex>
+#include <QRect>
+#include <QSize>
+#include <QThread>
+#include <QWaitCondition>
+#include <memory>
+#include <vector>
+#include "renderer.h"
+#include "renderstats.h"
+#include "scene.h"
+
+class FrameProfiler;
+
+// Renders scene snapshots on a dedicated thread into a ring of frame
+// buffers, so input handling never waits for a frame.
+//
+// The GUI thread posts a copy of the scene together with the screen region
+// it changed. The thread always renders the most recent snapshot into a
+// buffer that is neither the latest finished frame nor the one being
+// presented. Every buffer collects the damage posted since it was last
+// drawn and redraws only that. Snapshots posted while a frame is in flight
+// are merged into the next one.
+//
+// Snapshots also carry the size of the frame to render. A buffer is resized
+// and redrawn whole the next time it is drawn at another size, so frames
+// already finished or on screen keep their size until they are replaced.
+class RenderThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    RenderThread(int width, int height, QObject *parent = nullptr);
+    ~RenderThread() override;
+
+    void submit(const Scene& scene, const QRect& damage, const QSize& size);
+    // Latest finished frame, or nullptr before the first one. The frame
+    // stays untouched until releaseFrame().
+    const FrameBuffer* acquireFrame();
+    void releaseFrame();
+    // Snapshots that were replaced by a newer one before being rendered.
+    int droppedSceneCount() const;
+    // Counters of the latest finished frame.
+    RenderStats frameStats() const;
+    // Times render stages of the following frames and hands their stats to
+    // profiler, when it is not null. The profiler must outlive the thread.
+    void setProfiling(bool enabled, FrameProfiler *profiler);
+
+signals:
+    // Emitted from the render thread; damage covers everything that differs
+    // from the previous finished frame.
+    void frameReady(const QRect& damage);
+
+protected:
+    void run() override;
+
+private:
+    struct Buffer {
+        std::unique_ptr<Renderer> renderer;
+        QRect damage;
+    };
+    int pickTarget() const;
+
+    mutable QMutex mutex;
+    QWaitCondition sceneChanged;
+    std::vector<Buffer> buffers;
+    Scene scene;
+    QSize frameSize;
+    bool sceneDirty;
+    bool quitting;
+    int droppedScenes;
+    bool profiling;
+    FrameProfiler *profiler;
+    RenderStats latestStats;
+    int latest;
+    int presented;
+};
+
+#endif // RENDERTHREAD_H
@@ -0,0 +1,67 @@
+#include "resolutiongovernor.h"
+
+#include <algorithm>
+#include <cmath>
+
+const qreal scaleStep = 0.125;
+const qreal minimumScale = 0.25;
+const double budgetHeadroom = 0.8;
+const double smoothing = 0.5;
+// Frames in a row with room for the next step before it is taken.
+const int raiseDelay = 8;
+
+ResolutionGovernor::ResolutionGovernor(qint64 budgetNsecs)
+    : budgetNsecs(budgetNsecs)
+    , currentScale(1)
+    , fullFrameNsecs(0)
+    , roomyFrames(0)
+{
+
+}
+
+void ResolutionGovernor::setBudget(qint64 nsecs) {
+    budgetNsecs = nsecs;
+    fullFrameNsecs = 0;
+    roomyFrames = 0;
+}
+
+bool ResolutionGovernor::recordFrame(qint64 nsecs, qreal renderedScale) {
+    if (budgetNsecs <= 0 || renderedScale <= 0) {
+        return false;
+    }
+    const double estimate = nsecs / (renderedScale * renderedScale);
+    fullFrameNsecs = fullFrameNsecs > 0 ? fullFrameNsecs + smoothing * (estimate - fullFrameNsecs) : estimate;
+
+    const qreal fitting = fittingScale();
+    if (fitting < currentScale) {
+        currentScale = fitting;
+        roomyFrames = 0;
+        return true;
+    }
+    if (fitting == currentScale) {
+        roomyFrames = 0;
+        return false;
+    }
+    if (++roomyFrames < raiseDelay) {
+        return false;
+    }
+    currentScale = std::min(currentScale + scaleStep, fitting);
+    roomyFrames = 0;
+    return true;
+}
+
+bool ResolutionGovernor::reset() {
+    roomyFrames = 0;
+    if (currentScale == 1) {
+        return false;
+    }
+    currentScale = 1;
+    return true;
+}
+
+qreal ResolutionGovernor::fittingScale() const {
+    const qreal scale = std::sqrt(budgetHeadroom * budgetNsecs / fullFrameNsecs);
+    // Whole steps only, so the frame size settles instead of following
+    // every bit of noise in the timings.
+    return std::max(std::min(std::floor(scale / scaleStep) * scaleStep, qreal(1)), minimumScale);
+}
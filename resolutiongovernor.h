@@ -0,0 +1,44 @@
+#ifndef RESOLUTIONGOVERNOR_H
+#define RESOLUTIONGOVERNOR_H
+
+#include <QtGlobal>
+
+// Picks the fraction of the full resolution to render at so that frames
+// fit into a time budget. Render time grows with the number of pixels, so
+// every measured frame, whatever scale it was rendered at, gives an
+// estimate of what the same frame costs at full resolution; the scale is
+// the largest step whose frames should take at most budgetHeadroom of the
+// budget. Frames only redraw what changed, and what changed shrinks with
+// the scale like the whole frame does, so callers should pass the frames
+// that are typical of the scene moving and leave out whole redraws, such
+// as the ones after a change of scale.
+//
+// The scale drops as soon as the estimate says it has to and climbs back
+// one step at a time, only after several frames in a row had room for it,
+// so it does not flip back and forth around the budget. reset() goes back
+// to full resolution at once, for when the scene stops moving.
+class ResolutionGovernor {
+public:
+    // A budget of 0 keeps the full resolution.
+    explicit ResolutionGovernor(qint64 budgetNsecs = 0);
+
+    qint64 budget() const { return budgetNsecs; }
+    void setBudget(qint64 nsecs);
+    qreal scale() const { return currentScale; }
+    // Takes the render time of a frame rendered at renderedScale times the
+    // full resolution. Returns whether scale() changed.
+    bool recordFrame(qint64 nsecs, qreal renderedScale);
+    // Returns whether scale() changed.
+    bool reset();
+
+private:
+    qreal fittingScale() const;
+
+    qint64 budgetNsecs;
+    qreal currentScale;
+    // Smoothed estimate of a frame at full resolution, 0 before the first.
+    double fullFrameNsecs;
+    int roomyFrames;
+};
+
+#endif // RESOLUTIONGOVERNOR_H
@@ -0,0 +1,385 @@
+#include "samplebuffer.h"
+
+#include <QtGlobal>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(Q_PROCESSOR_X86) && defined(__SSE2__)
+#define SAMPLEBUFFER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+SamplePattern makePattern(int count, const int (*offsets)[2]) {
+    SamplePattern pattern;
+    pattern.count = count;
+    // Both patterns are centered on the sample point, so the mean of the
+    // keys is the key there and the slopes follow from the normal
+    // equations of the least-squares plane.
+    float xx = 0, xy = 0, yy = 0;
+    for (int s = 0; s < count; s++) {
+        pattern.x[s] = offsets[s][0];
+        pattern.y[s] = offsets[s][1];
+        pattern.offsetX[s] = offsets[s][0] / 16.f;
+        pattern.offsetY[s] = offsets[s][1] / 16.f;
+        xx += pattern.offsetX[s] * pattern.offsetX[s];
+        xy += pattern.offsetX[s] * pattern.offsetY[s];
+        yy += pattern.offsetY[s] * pattern.offsetY[s];
+    }
+    const float determinant = xx * yy - xy * xy;
+    for (int s = 0; s < count; s++) {
+        pattern.slopeWeightX[s] = (yy * pattern.offsetX[s] - xy * pattern.offsetY[s]) / determinant;
+        pattern.slopeWeightY[s] = (xx * pattern.offsetY[s] - xy * pattern.offsetX[s]) / determinant;
+    }
+    return pattern;
+}
+
+#ifdef SAMPLEBUFFER_SSE2
+
+// Widens the channels to 16 bits, 4 samples per load, and sums them up;
+// 8 samples of 255 still fit.
+QRgb averageColors(const QRgb* colors, int count, int shift) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = zero;
+    for (int i = 0; i < count; i += 4) {
+        const __m128i four = _mm_loadu_si128(reinterpret_cast<const __m128i*>(colors + i));
+        sum = _mm_add_epi16(sum, _mm_add_epi16(_mm_unpacklo_epi8(four, zero), _mm_unpackhi_epi8(four, zero)));
+    }
+    sum = _mm_add_epi16(sum, _mm_srli_si128(sum, 8));
+    sum = _mm_srl_epi16(_mm_add_epi16(sum, _mm_set1_epi16(static_cast<short>(count / 2))), _mm_cvtsi32_si128(shift));
+    return static_cast<QRgb>(_mm_cvtsi128_si32(_mm_packus_epi16(sum, sum)));
+}
+
+// Keys of all samples of one pixel, four to a register.
+template<int Samples>
+struct PixelKeys {
+    static const int lanes = Samples / 4;
+
+    static PixelKeys load(const float* keys) {
+        PixelKeys loaded;
+        for (int lane = 0; lane < lanes; lane++) {
+            loaded.keys[lane] = _mm_loadu_ps(keys + lane * 4);
+        }
+        return loaded;
+    }
+    static PixelKeys plane(float center, float slopeX, float slopeY, const SamplePattern& pattern) {
+        PixelKeys planeKeys;
+        for (int lane = 0; lane < lanes; lane++) {
+            planeKeys.keys[lane] = _mm_add_ps(_mm_set1_ps(center),
+                                              _mm_add_ps(_mm_mul_ps(_mm_set1_ps(slopeX), _mm_loadu_ps(pattern.offsetX + lane * 4)),
+                                                         _mm_mul_ps(_mm_set1_ps(slopeY), _mm_loadu_ps(pattern.offsetY + lane * 4))));
+        }
+        return planeKeys;
+    }
+    void store(float* keys) const {
+        for (int lane = 0; lane < lanes; lane++) {
+            _mm_storeu_ps(keys + lane * 4, this->keys[lane]);
+        }
+    }
+    // Samples where these keys are smaller than other's.
+    unsigned nearer(const PixelKeys& other) const {
+        unsigned mask = 0;
+        for (int lane = 0; lane < lanes; lane++) {
+            mask |= static_cast<unsigned>(_mm_movemask_ps(_mm_cmplt_ps(keys[lane], other.keys[lane]))) << lane * 4;
+        }
+        return mask;
+    }
+    float farthest() const {
+        __m128 farthest = keys[0];
+        for (int lane = 1; lane < lanes; lane++) {
+            farthest = _mm_max_ps(farthest, keys[lane]);
+        }
+        farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(1, 0, 3, 2)));
+        farthest = _mm_max_ps(farthest, _mm_shuffle_ps(farthest, farthest, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtss_f32(farthest);
+    }
+    // The least-squares plane through the keys.
+    void fit(const SamplePattern& pattern, float& center, float& slopeX, float& slopeY) const {
+        __m128 sum = _mm_setzero_ps(), sumX = _mm_setzero_ps(), sumY = _mm_setzero_ps(), unused = _mm_setzero_ps();
+        for (int lane = 0; lane < lanes; lane++) {
+            sum = _mm_add_ps(sum, keys[lane]);
+            sumX = _mm_add_ps(sumX, _mm_mul_ps(keys[lane], _mm_loadu_ps(pattern.slopeWeightX + lane * 4)));
+            sumY = _mm_add_ps(sumY, _mm_mul_ps(keys[lane], _mm_loadu_ps(pattern.slopeWeightY + lane * 4)));
+        }
+        _MM_TRANSPOSE4_PS(sum, sumX, sumY, unused);
+        float sums[4];
+        _mm_storeu_ps(sums, _mm_add_ps(_mm_add_ps(sum, sumX), _mm_add_ps(sumY, unused)));
+        center = sums[0] / Samples;
+        slopeX = sums[1];
+        slopeY = sums[2];
+    }
+
+    __m128 keys[lanes];
+};
+
+#else
+
+QRgb averageColors(const QRgb* colors, int count, int shift) {
+    QRgb average = 0;
+    for (int channel = 0; channel < 32; channel += 8) {
+        int sum = count / 2;
+        for (int i = 0; i < count; i++) {
+            sum += colors[i] >> channel & 0xff;
+        }
+        average |= static_cast<QRgb>(sum >> shift) << channel;
+    }
+    return average;
+}
+
+template<int Samples>
+struct PixelKeys {
+    static PixelKeys load(const float* keys) {
+        PixelKeys loaded;
+        std::copy(keys, keys + Samples, loaded.keys);
+        return loaded;
+    }
+    static PixelKeys plane(float center, float slopeX, float slopeY, const SamplePattern& pattern) {
+        PixelKeys planeKeys;
+        for (int s = 0; s < Samples; s++) {
+            planeKeys.keys[s] = center + (slopeX * pattern.offsetX[s] + slopeY * pattern.offsetY[s]);
+        }
+        return planeKeys;
+    }
+    void store(float* keys) const { std::copy(this->keys, this->keys + Samples, keys); }
+    unsigned nearer(const PixelKeys& other) const {
+        unsigned mask = 0;
+        for (int s = 0; s < Samples; s++) {
+            mask |= (keys[s] < other.keys[s] ? 1u : 0u) << s;
+        }
+        return mask;
+    }
+    float farthest() const { return *std::max_element(keys, keys + Samples); }
+    void fit(const SamplePattern& pattern, float& center, float& slopeX, float& slopeY) const {
+        float sum = 0;
+        slopeX = 0;
+        slopeY = 0;
+        for (int s = 0; s < Samples; s++) {
+            sum += keys[s];
+            slopeX += pattern.slopeWeightX[s] * keys[s];
+            slopeY += pattern.slopeWeightY[s] * keys[s];
+        }
+        center = sum / Samples;
+    }
+
+    float keys[Samples];
+};
+
+#endif // SAMPLEBUFFER_SSE2
+
+}
+
+const SamplePattern* samplePattern(int samples) {
+    static const int offsets4[4][2] = {{-2, -6}, {6, -2}, {-6, 2}, {2, 6}};
+    static const int offsets8[8][2] = {{1, -3}, {-1, 3}, {5, 1}, {-3, -5}, {-5, 5}, {-7, -1}, {3, 7}, {7, -7}};
+    static const SamplePattern pattern4 = makePattern(4, offsets4);
+    static const SamplePattern pattern8 = makePattern(8, offsets8);
+    switch (samples) {
+    case 4:
+        return &pattern4;
+    case 8:
+        return &pattern8;
+    default:
+        return nullptr;
+    }
+}
+
+SampleBuffer::SampleBuffer()
+    : currentPattern(samplePattern(4))
+    , clearedKey(std::numeric_limits<float>::max())
+{
+
+}
+
+void SampleBuffer::reset(const QRect& rect, const SamplePattern& pattern, float farthestKey) {
+    currentPattern = &pattern;
+    area = rect;
+    clearedKey = farthestKey;
+    const size_t pixels = static_cast<size_t>(rect.width()) * rect.height();
+    // Only the states are cleared; the key planes of a pixel are written
+    // when it is first covered.
+    centerKeys.resize(pixels);
+    slopesX.resize(pixels);
+    slopesY.resize(pixels);
+    sampleStarts.assign(pixels, cleared);
+    sampleColors.clear();
+    sampleKeys.clear();
+    expandedPixels.clear();
+}
+
+void SampleBuffer::expand(int index, QRgb color) {
+    sampleStarts[index] = static_cast<int>(sampleKeys.size());
+    sampleKeys.resize(sampleKeys.size() + currentPattern->count);
+    sampleColors.resize(sampleColors.size() + currentPattern->count, color);
+    expandedPixels.push_back(index);
+}
+
+int SampleBuffer::writeRow(int y, int fromX, int count, const unsigned* masks, const float* keys, const QRgb* colors,
+                           QRgb* pixels, float* farthestKeys) {
+    // With the sample count known at compile time the loops over samples
+    // unroll into a vector or two.
+    const int index = pixelIndex(fromX, y);
+    int passed = 0;
+    if (currentPattern->count == 8) {
+        for (int i = 0; i < count; i++) {
+            passed += masks[i] != 0 && writePixel<8>(index + i, masks[i], keys + i * 8, colors[i], pixels[i], farthestKeys[i]);
+        }
+    } else {
+        for (int i = 0; i < count; i++) {
+            passed += masks[i] != 0 && writePixel<4>(index + i, masks[i], keys + i * 4, colors[i], pixels[i], farthestKeys[i]);
+        }
+    }
+    return passed;
+}
+
+int SampleBuffer::writePlaneRow(int y, int fromX, int count, float centerKey, float slopeX, float slopeY,
+                                const QRgb* colors, QRgb* pixels, float* farthestKeys) {
+    if (currentPattern->count == 8) {
+        return writePlanePixels<8>(pixelIndex(fromX, y), count, centerKey, slopeX, slopeY, colors, pixels, farthestKeys);
+    }
+    return writePlanePixels<4>(pixelIndex(fromX, y), count, centerKey, slopeX, slopeY, colors, pixels, farthestKeys);
+}
+
+template<int Samples>
+bool SampleBuffer::writePixel(int index, unsigned mask, const float* keys, QRgb color, QRgb& pixel, float& farthestKey) {
+    const SamplePattern& pattern = *currentPattern;
+    const PixelKeys<Samples> incoming = PixelKeys<Samples>::load(keys);
+    const int start = sampleStarts[index];
+    PixelKeys<Samples> stored;
+    if (start == cleared) {
+        stored = PixelKeys<Samples>::plane(clearedKey, 0, 0, pattern);
+    } else if (start == compressed) {
+        stored = PixelKeys<Samples>::plane(centerKeys[index], slopesX[index], slopesY[index], pattern);
+    } else {
+        stored = PixelKeys<Samples>::load(&sampleKeys[start]);
+    }
+    const unsigned passing = incoming.nearer(stored) & mask;
+    if (passing == 0) {
+        return false;
+    }
+
+    if (passing == (1u << Samples) - 1) {
+        // One fragment owns the whole pixel, even if it was split before.
+        incoming.fit(pattern, centerKeys[index], slopesX[index], slopesY[index]);
+        sampleStarts[index] = compressed;
+        pixel = color;
+        farthestKey = incoming.farthest();
+        return true;
+    }
+
+    if (start < 0) {
+        expand(index, pixel);
+        stored.store(&sampleKeys[sampleStarts[index]]);
+    }
+    float* sampleKey = &sampleKeys[sampleStarts[index]];
+    QRgb* sampleColor = &sampleColors[sampleStarts[index]];
+    for (int s = 0; s < Samples; s++) {
+        if ((passing >> s & 1) != 0) {
+            sampleKey[s] = keys[s];
+            sampleColor[s] = color;
+        }
+    }
+    farthestKey = PixelKeys<Samples>::load(sampleKey).farthest();
+    return true;
+}
+
+template<int Samples>
+bool SampleBuffer::writePlanePixel(int index, float key, float slopeX, float slopeY, float farthestOffset, QRgb color,
+                                   QRgb& pixel, float& farthestKey) {
+    const int start = sampleStarts[index];
+    if (start < 0) {
+        // Samples lie within half a pixel of the sample point, so the
+        // planes cannot cross inside the pixel when they are further apart
+        // there than half their difference in slopes. The fragment then
+        // takes the pixel as it is or fails everywhere.
+        const bool isCleared = start == cleared;
+        const float storedKey = isCleared ? clearedKey : centerKeys[index];
+        const float storedSlopeX = isCleared ? 0 : slopesX[index];
+        const float storedSlopeY = isCleared ? 0 : slopesY[index];
+        const float margin = (std::abs(slopeX - storedSlopeX) + std::abs(slopeY - storedSlopeY)) * 0.5f;
+        if (key - storedKey + margin < 0) {
+            centerKeys[index] = key;
+            slopesX[index] = slopeX;
+            slopesY[index] = slopeY;
+            sampleStarts[index] = compressed;
+            pixel = color;
+            farthestKey = key + farthestOffset;
+            return true;
+        }
+        if (key - storedKey - margin >= 0) {
+            return false;
+        }
+    }
+    float keys[Samples];
+    PixelKeys<Samples>::plane(key, slopeX, slopeY, *currentPattern).store(keys);
+    return writePixel<Samples>(index, (1u << Samples) - 1, keys, color, pixel, farthestKey);
+}
+
+template<int Samples>
+int SampleBuffer::writePlanePixels(int index, int count, float centerKey, float slopeX, float slopeY,
+                                   const QRgb* colors, QRgb* pixels, float* farthestKeys) {
+    // Offset of the farthest sample from the sample point, the same for
+    // every pixel of the plane.
+    float offsets[Samples];
+    PixelKeys<Samples>::plane(0, slopeX, slopeY, *currentPattern).store(offsets);
+    const float farthestOffset = *std::max_element(offsets, offsets + Samples);
+    int passed = 0;
+    int i = 0;
+#ifdef SAMPLEBUFFER_SSE2
+    // Four pixels at a time, the common case inside a primitive, where the
+    // fragment takes all four by the test of writePlanePixel().
+    const __m128 lanes = _mm_setr_ps(0, 1, 2, 3);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 slopeXs = _mm_set1_ps(slopeX);
+    const __m128 slopeYs = _mm_set1_ps(slopeY);
+    for (; i + 4 <= count; i += 4) {
+        const int at = index + i;
+        const __m128i starts = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&sampleStarts[at]));
+        const __m128 isCleared = _mm_castsi128_ps(_mm_cmpeq_epi32(starts, _mm_set1_epi32(cleared)));
+        const __m128 storedKeys = _mm_or_ps(_mm_and_ps(isCleared, _mm_set1_ps(clearedKey)),
+                                            _mm_andnot_ps(isCleared, _mm_loadu_ps(&centerKeys[at])));
+        const __m128 storedSlopesX = _mm_andnot_ps(isCleared, _mm_loadu_ps(&slopesX[at]));
+        const __m128 storedSlopesY = _mm_andnot_ps(isCleared, _mm_loadu_ps(&slopesY[at]));
+        const __m128 keys = _mm_add_ps(_mm_set1_ps(centerKey), _mm_mul_ps(_mm_add_ps(_mm_set1_ps(i), lanes), slopeXs));
+        const __m128 margins = _mm_mul_ps(_mm_add_ps(_mm_and_ps(_mm_sub_ps(slopeXs, storedSlopesX), absMask),
+                                                     _mm_and_ps(_mm_sub_ps(slopeYs, storedSlopesY), absMask)), half);
+        const __m128 nearer = _mm_cmplt_ps(_mm_add_ps(_mm_sub_ps(keys, storedKeys), margins), _mm_setzero_ps());
+        const __m128i isPlane = _mm_cmplt_epi32(starts, _mm_setzero_si128());
+        if (_mm_movemask_ps(_mm_and_ps(nearer, _mm_castsi128_ps(isPlane))) != 0xf) {
+            for (int pixel = i; pixel < i + 4; pixel++) {
+                passed += writePlanePixel<Samples>(index + pixel, centerKey + pixel * slopeX, slopeX, slopeY,
+                                                   farthestOffset, colors[pixel], pixels[pixel], farthestKeys[pixel]);
+            }
+            continue;
+        }
+        _mm_storeu_ps(&centerKeys[at], keys);
+        _mm_storeu_ps(&slopesX[at], slopeXs);
+        _mm_storeu_ps(&slopesY[at], slopeYs);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&sampleStarts[at]), _mm_set1_epi32(compressed));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i), _mm_loadu_si128(reinterpret_cast<const __m128i*>(colors + i)));
+        _mm_storeu_ps(farthestKeys + i, _mm_add_ps(keys, _mm_set1_ps(farthestOffset)));
+        passed += 4;
+    }
+#endif
+    for (; i < count; i++) {
+        passed += writePlanePixel<Samples>(index + i, centerKey + i * slopeX, slopeX, slopeY, farthestOffset, colors[i],
+                                           pixels[i], farthestKeys[i]);
+    }
+    return passed;
+}
+
+void SampleBuffer::resolve(BufferPlane<QRgb>& colors) const {
+    const int count = currentPattern->count;
+    const int shift = count == 8 ? 3 : 2;
+    for (int index : expandedPixels) {
+        // Pixels compressed again since hold their color already.
+        if (sampleStarts[index] == compressed) {
+            continue;
+        }
+        const int x = area.left() + index % area.width();
+        const int y = area.top() + index / area.width();
+        colors.row(y)[x] = averageColors(&sampleColors[sampleStarts[index]], count, shift);
+    }
+}
@@ -0,0 +1,145 @@
+#ifndef SAMPLEBUFFER_H
+#define SAMPLEBUFFER_H
+
+#include <QRect>
+#include <QRgb>
+#include <algorithm>
+#include <vector>
+#include "framebuffer.h"
+
+// Where the samples of one pixel lie in multisampled rendering, as offsets
+// from the pixel's sample point at whole coordinates. These are the
+// standard 4x and 8x patterns of Direct3D, in 1/16 of a pixel, so every
+// offset is exact in the rasterizer's fixed point as well.
+struct SamplePattern {
+    static const int maxCount = 8;
+
+    int count;
+    // In 1/16 of a pixel.
+    int x[maxCount], y[maxCount];
+    // In pixels.
+    float offsetX[maxCount], offsetY[maxCount];
+    // Least-squares weights that turn the keys of all samples into the
+    // slopes of the plane through them; see SampleBuffer.
+    float slopeWeightX[maxCount], slopeWeightY[maxCount];
+
+    unsigned allSamples() const { return (1u << count) - 1; }
+};
+
+// The pattern of 4 or 8 samples per pixel, or nullptr for any other count.
+const SamplePattern* samplePattern(int samples);
+
+// Pixels of one row of a multisampled primitive, inside clip: sample s
+// covers [from[s], to[s]]. Every sample covers the inner span, and the
+// union spans everything any of them covers.
+struct SampleSpans {
+    SampleSpans(const SamplePattern& pattern, const QRect& clip)
+        : pattern(pattern)
+        , unionFrom(clip.right() + 1)
+        , unionTo(clip.left() - 1)
+        , innerFrom(clip.left())
+        , innerTo(clip.right())
+    {
+
+    }
+    // An empty span, from > to, leaves the union alone.
+    void add(int sample, int fromX, int toX) {
+        from[sample] = fromX;
+        to[sample] = toX;
+        if (fromX <= toX) {
+            unionFrom = std::min(unionFrom, fromX);
+            unionTo = std::max(unionTo, toX);
+        }
+        innerFrom = std::max(innerFrom, fromX);
+        innerTo = std::min(innerTo, toX);
+    }
+    bool isEmpty() const { return unionFrom > unionTo; }
+    // Samples of pixel x that are covered.
+    unsigned mask(int x) const {
+        if (x >= innerFrom && x <= innerTo) {
+            return pattern.allSamples();
+        }
+        unsigned covered = 0;
+        for (int s = 0; s < pattern.count; s++) {
+            covered |= (x >= from[s] && x <= to[s] ? 1u : 0u) << s;
+        }
+        return covered;
+    }
+
+    const SamplePattern& pattern;
+    int from[SamplePattern::maxCount], to[SamplePattern::maxCount];
+    int unionFrom, unionTo, innerFrom, innerTo;
+};
+
+// Depth keys (see depthformat.h) and colors of every sample of one tile
+// while it is drawn multisampled, compressed where that loses nothing.
+//
+// A pixel starts out compressed: one color for all of its samples, which
+// lives in the color plane, and the depth of its samples as a plane, its
+// key at the pixel's sample point and the slopes along x and y. A fragment
+// covering every sample that wins every depth test keeps it that way, so
+// the inside of a primitive costs one color and three floats per pixel.
+// Only when a pixel ends up split between fragments, along edges and where
+// surfaces intersect, it is expanded into a color and a key per sample.
+//
+// Every sample is tested at its own depth, expanded or not. resolve()
+// averages the samples of expanded pixels into the color plane; compressed
+// ones are already there.
+class SampleBuffer {
+public:
+    SampleBuffer();
+
+    const SamplePattern& pattern() const { return *currentPattern; }
+    // Makes every pixel of rect a compressed one at farthestKey, for
+    // pattern.
+    void reset(const QRect& rect, const SamplePattern& pattern, float farthestKey);
+    // Tests count fragments of row y from fromX on against the samples of
+    // their pixels and takes the ones where they are nearer. Fragment i
+    // covers the samples in masks[i], has key keys[i * pattern().count + s]
+    // at sample s and is shaded colors[i]; pixels are the pixels in the
+    // color plane. Returns the number of fragments that passed anywhere;
+    // for those farthestKeys[i] is then the farthest key left in the pixel,
+    // for the others it is left alone.
+    int writeRow(int y, int fromX, int count, const unsigned* masks, const float* keys, const QRgb* colors,
+                 QRgb* pixels, float* farthestKeys);
+    // writeRow() for a fragment that covers every sample of its pixels and
+    // whose keys lie in a plane: centerKey + i * slopeX at the sample point
+    // of pixel i, growing by slopeX and slopeY per pixel along x and y.
+    // Where it is nearer than a compressed pixel by a safe margin it takes
+    // the pixel without looking at the samples one by one.
+    int writePlaneRow(int y, int fromX, int count, float centerKey, float slopeX, float slopeY, const QRgb* colors,
+                      QRgb* pixels, float* farthestKeys);
+    // Averages the samples of every expanded pixel into colors.
+    void resolve(BufferPlane<QRgb>& colors) const;
+
+private:
+    // States of a pixel besides expanded, where it is the start of its
+    // samples.
+    enum { compressed = -1, cleared = -2 };
+
+    int pixelIndex(int x, int y) const { return (y - area.top()) * area.width() + x - area.left(); }
+    template<int Samples>
+    bool writePixel(int index, unsigned mask, const float* keys, QRgb color, QRgb& pixel, float& farthestKey);
+    template<int Samples>
+    bool writePlanePixel(int index, float key, float slopeX, float slopeY, float farthestOffset, QRgb color, QRgb& pixel,
+                         float& farthestKey);
+    template<int Samples>
+    int writePlanePixels(int index, int count, float centerKey, float slopeX, float slopeY, const QRgb* colors,
+                         QRgb* pixels, float* farthestKeys);
+    // Gives the pixel room for its samples, all of them color.
+    void expand(int index, QRgb color);
+
+    const SamplePattern* currentPattern;
+    QRect area;
+    float clearedKey;
+    // Per pixel of area: the key plane of compressed pixels, and its state
+    // or where the samples of expanded ones start in the arrays below.
+    std::vector<float> centerKeys, slopesX, slopesY;
+    std::vector<int> sampleStarts;
+    std::vector<QRgb> sampleColors;
+    std::vector<float> sampleKeys;
+    // Pixel indices in the order they were expanded.
+    std::vector<int> expandedPixels;
+};
+
+#endif // SAMPLEBUFFER_H
@@ -0,0 +1,84 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <QColor>
+#include <QMatrix4x4>
+#include <QVector3D>
+#include <memory>
+#include <vector>
+#include "depthformat.h"
+#include "mesh.h"
+
+// Sphere in world space, the space the mesh lands in after expansionCoeff
+// and the offsets, where x and y are pixels and z is depth.
+struct Sphere {
+    QVector3D center;
+    float radius;
+};
+
+// Everything the renderer needs to know to draw one frame. The mesh and the
+// spheres are shared and never modified once they are in a Scene, so copies
+// are cheap.
+//
+// A mesh position p lands on screen at
+//     pixelScale * projection * view * offset * expansionCoeff * model * p
+// followed by the divide by w. With view and projection left at identity x
+// and y come out in pixels and z as depth, an orthographic view.
+// pixelScale only scales x and y, from those pixels to the pixels of the
+// render target, so a scene looks the same at any resolution.
+struct Scene {
+    std::shared_ptr<const Mesh> mesh = std::make_shared<const Mesh>(Mesh::cube());
+    // The globe by default.
+    std::shared_ptr<const std::vector<Sphere>> spheres =
+        std::make_shared<const std::vector<Sphere>>(1, Sphere{QVector3D(200, 200, 200), 100});
+    int offsetX = 200;
+    int offsetY = 200;
+    int offsetZ = 200;
+    int expansionCoeff = 50;
+    // Rotates the mesh about its own origin.
+    QMatrix4x4 model;
+    QMatrix4x4 view;
+    QMatrix4x4 projection;
+    float pixelScale = 1;
+    QColor edgeColor = Qt::black;
+    QColor cubeColor = Qt::blue;
+    QColor sphereColor = Qt::red;
+    QColor backgroundColor = Qt::white;
+    DepthFormat depthFormat = DepthFormat::Float32;
+    // Depths the fixed-point and reverse-Z formats can tell apart; anything
+    // nearer or farther is clamped to the ends.
+    float depthNear = -1024;
+    float depthFar = 3072;
+    // Samples per pixel: 1, or 4 or 8 for multisample antialiasing.
+    int samples = 1;
+    // Edges are edgeWidth pixels wide and tested and stored edgeDepthBias
+    // nearer than they are, so they stay on top of the faces they bound
+    // rather than fighting them over pixels where both round to the same
+    // depth.
+    float edgeWidth = 1;
+    float edgeDepthBias = 1;
+
+    QMatrix4x4 viewProjection() const {
+        QMatrix4x4 toTarget;
+        toTarget.scale(pixelScale, pixelScale, 1);
+        return toTarget * projection * view;
+    }
+    QMatrix4x4 meshTransform() const {
+        QMatrix4x4 transform = viewProjection();
+        transform.translate(offsetX, offsetY, offsetZ);
+        transform.scale(expansionCoeff);
+        return transform * model;
+    }
+
+    // Perspective in the pixel space above, seen from eyeDistance in front
+    // of the z = 0 plane, which keeps its scale. Lines of sight converge on
+    // (centerX, centerY) and z / w still grows with depth.
+    static QMatrix4x4 perspective(float eyeDistance, float centerX, float centerY) {
+        return QMatrix4x4(1, 0, centerX / eyeDistance, 0,
+                          0, 1, centerY / eyeDistance, 0,
+                          0, 0, 1, 0,
+                          0, 0, 1 / eyeDistance, 1);
+    }
+};
+
+#endif // SCENE_H
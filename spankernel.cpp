@@ -0,0 +1,428 @@
+#include "spankernel.h"
+
+#include <QtGlobal>
+
+#if defined(Q_PROCESSOR_X86) && (defined(Q_CC_GNU) || defined(Q_CC_CLANG))
+#define SPANKERNEL_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// The linear, the explicit and the sphere z variants share one body; ZSource
+// hands out the z of pixel i either way.
+struct LinearZ {
+    float z0, dz;
+    float at(int i) const { return z0 + i * dz; }
+};
+
+struct ArrayZ {
+    const float* z;
+    float at(int i) const { return z[i]; }
+};
+
+struct SphereZ {
+    float dx0, rowQ, centerZ, depthScale;
+    float at(int i) const { return sphereZ(dx0 + i, rowQ, centerZ, depthScale); }
+};
+
+template<class Depth, class ZSource>
+int shadeScalar(QRgb* colors, typename Depth::Value* depths, const Depth& format, int from, int count, ZSource z,
+                QRgb color, float colorCoeff) {
+    int passed = 0;
+    for (int i = from; i < count; i++) {
+        passed += shadePixel(colors[i], depths[i], z.at(i), color, colorCoeff, format);
+    }
+    return passed;
+}
+
+template<class Depth, class ZSource>
+int shadeScalar(QRgb* colors, typename Depth::Value* depths, const Depth& format, uint8_t* ids, uint8_t objectId,
+                int count, ZSource z, QRgb color, float colorCoeff) {
+    int passed = 0;
+    for (int i = 0; i < count; i++) {
+        if (shadePixel(colors[i], depths[i], z.at(i), color, colorCoeff, format)) {
+            ids[i] = objectId;
+            passed++;
+        }
+    }
+    return passed;
+}
+
+void shadeColorsScalar(QRgb* colors, int from, int count, const float* z, QRgb color, float colorCoeff) {
+    for (int i = from; i < count; i++) {
+        colors[i] = qRgb(shadeChannel(qRed(color), z[i], colorCoeff), shadeChannel(qGreen(color), z[i], colorCoeff),
+                         shadeChannel(qBlue(color), z[i], colorCoeff));
+    }
+}
+
+#ifdef SPANKERNEL_X86
+
+inline __m128 loadZ(LinearZ z, int i) {
+    const __m128 lanes = _mm_setr_ps(0, 1, 2, 3);
+    return _mm_add_ps(_mm_set1_ps(z.z0), _mm_mul_ps(_mm_add_ps(_mm_set1_ps(i), lanes), _mm_set1_ps(z.dz)));
+}
+
+inline __m128 loadZ(ArrayZ z, int i) {
+    return _mm_loadu_ps(z.z + i);
+}
+
+inline __m128 loadZ(SphereZ z, int i) {
+    const __m128 lanes = _mm_setr_ps(0, 1, 2, 3);
+    const __m128 dx = _mm_add_ps(_mm_set1_ps(z.dx0), _mm_add_ps(_mm_set1_ps(i), lanes));
+    const __m128 q = _mm_max_ps(_mm_sub_ps(_mm_set1_ps(z.rowQ), _mm_mul_ps(dx, dx)), _mm_setzero_ps());
+    return _mm_sub_ps(_mm_set1_ps(z.centerZ), _mm_mul_ps(_mm_set1_ps(z.depthScale), _mm_sqrt_ps(q)));
+}
+
+// Loading, encoding, testing and storing 4 (SSE2) or 8 (AVX2) depths of
+// one format. Stored values are widened to float lanes, which holds every
+// 16- and 24-bit integer exactly, and narrowed back on the way out.
+template<class Depth>
+struct DepthLanes;
+
+template<>
+struct DepthLanes<FloatDepth> {
+    static __m128 encode(const FloatDepth&, __m128 z) { return z; }
+    static __m128 load(const float* depths) { return _mm_loadu_ps(depths); }
+    static __m128 passes(__m128 incoming, __m128 stored) { return _mm_cmpgt_ps(stored, incoming); }
+    static void store(float* depths, __m128 values) { _mm_storeu_ps(depths, values); }
+
+    __attribute__((target("avx2")))
+    static __m256 encode(const FloatDepth&, __m256 z) { return z; }
+    __attribute__((target("avx2")))
+    static __m256 load8(const float* depths) { return _mm256_loadu_ps(depths); }
+    __attribute__((target("avx2")))
+    static __m256 passes(__m256 incoming, __m256 stored) { return _mm256_cmp_ps(stored, incoming, _CMP_GT_OQ); }
+    __attribute__((target("avx2")))
+    static void store(float* depths, __m256 values) { _mm256_storeu_ps(depths, values); }
+};
+
+template<>
+struct DepthLanes<ReverseFloatDepth> {
+    static __m128 encode(const ReverseFloatDepth& format, __m128 z) {
+        const __m128 mapped = _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(format.scale)), _mm_set1_ps(format.bias));
+        return _mm_min_ps(_mm_max_ps(mapped, _mm_setzero_ps()), _mm_set1_ps(1.f));
+    }
+    static __m128 load(const float* depths) { return _mm_loadu_ps(depths); }
+    static __m128 passes(__m128 incoming, __m128 stored) { return _mm_cmplt_ps(stored, incoming); }
+    static void store(float* depths, __m128 values) { _mm_storeu_ps(depths, values); }
+
+    __attribute__((target("avx2")))
+    static __m256 encode(const ReverseFloatDepth& format, __m256 z) {
+        const __m256 mapped = _mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(format.scale)), _mm256_set1_ps(format.bias));
+        return _mm256_min_ps(_mm256_max_ps(mapped, _mm256_setzero_ps()), _mm256_set1_ps(1.f));
+    }
+    __attribute__((target("avx2")))
+    static __m256 load8(const float* depths) { return _mm256_loadu_ps(depths); }
+    __attribute__((target("avx2")))
+    static __m256 passes(__m256 incoming, __m256 stored) { return _mm256_cmp_ps(stored, incoming, _CMP_LT_OQ); }
+    __attribute__((target("avx2")))
+    static void store(float* depths, __m256 values) { _mm256_storeu_ps(depths, values); }
+};
+
+inline __m128i loadUnorm(const uint32_t* depths) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(depths));
+}
+
+inline __m128i loadUnorm(const uint16_t* depths) {
+    return _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(depths)), _mm_setzero_si128());
+}
+
+inline void storeUnorm(uint32_t* depths, __m128i values) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(depths), values);
+}
+
+// SSE2 has no unsigned saturating pack from 32 to 16 bits, so the values
+// are shifted into the signed range and back.
+inline void storeUnorm(uint16_t* depths, __m128i values) {
+    const __m128i shifted = _mm_sub_epi32(values, _mm_set1_epi32(0x8000));
+    const __m128i packed = _mm_add_epi16(_mm_packs_epi32(shifted, shifted), _mm_set1_epi16(-0x8000));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(depths), packed);
+}
+
+__attribute__((target("avx2")))
+inline __m256i loadUnorm8(const uint32_t* depths) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(depths));
+}
+
+__attribute__((target("avx2")))
+inline __m256i loadUnorm8(const uint16_t* depths) {
+    return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(depths)));
+}
+
+__attribute__((target("avx2")))
+inline void storeUnorm(uint32_t* depths, __m256i values) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(depths), values);
+}
+
+__attribute__((target("avx2")))
+inline void storeUnorm(uint16_t* depths, __m256i values) {
+    const __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(values), _mm256_extracti128_si256(values, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(depths), packed);
+}
+
+template<int Bits, class T>
+struct DepthLanes<UnormDepth<Bits, T>> {
+    typedef UnormDepth<Bits, T> Format;
+
+    // Rounds to nearest even like the scalar encode, under the default
+    // rounding mode.
+    static __m128 encode(const Format& format, __m128 z) {
+        const __m128 mapped = _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(format.scale)), _mm_set1_ps(format.bias));
+        const __m128 clamped = _mm_min_ps(_mm_max_ps(mapped, _mm_setzero_ps()), _mm_set1_ps(Format::maxValue()));
+        return _mm_cvtepi32_ps(_mm_cvtps_epi32(clamped));
+    }
+    static __m128 load(const T* depths) { return _mm_cvtepi32_ps(loadUnorm(depths)); }
+    static __m128 passes(__m128 incoming, __m128 stored) { return _mm_cmpgt_ps(stored, incoming); }
+    static void store(T* depths, __m128 values) { storeUnorm(depths, _mm_cvttps_epi32(values)); }
+
+    __attribute__((target("avx2")))
+    static __m256 encode(const Format& format, __m256 z) {
+        const __m256 mapped = _mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(format.scale)), _mm256_set1_ps(format.bias));
+        const __m256 clamped = _mm256_min_ps(_mm256_max_ps(mapped, _mm256_setzero_ps()), _mm256_set1_ps(Format::maxValue()));
+        return _mm256_cvtepi32_ps(_mm256_cvtps_epi32(clamped));
+    }
+    __attribute__((target("avx2")))
+    static __m256 load8(const T* depths) { return _mm256_cvtepi32_ps(loadUnorm8(depths)); }
+    __attribute__((target("avx2")))
+    static __m256 passes(__m256 incoming, __m256 stored) { return _mm256_cmp_ps(stored, incoming, _CMP_GT_OQ); }
+    __attribute__((target("avx2")))
+    static void store(T* depths, __m256 values) { storeUnorm(depths, _mm256_cvttps_epi32(values)); }
+};
+
+inline __m128i shadeChannel4(__m128 channel, __m128 z, __m128 colorCoeff) {
+    const __m128 shaded = _mm_sub_ps(channel, _mm_mul_ps(z, colorCoeff));
+    return _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(shaded, _mm_setzero_ps()), _mm_set1_ps(255.f)));
+}
+
+template<class Depth, class ZSource>
+int shadeSse2(QRgb* colors, typename Depth::Value* depths, const Depth& format, int count, ZSource z, QRgb color,
+              float colorCoeff) {
+    typedef DepthLanes<Depth> Lanes;
+    const __m128 red = _mm_set1_ps(qRed(color));
+    const __m128 green = _mm_set1_ps(qGreen(color));
+    const __m128 blue = _mm_set1_ps(qBlue(color));
+    const __m128 coeff = _mm_set1_ps(colorCoeff);
+    const __m128i alpha = _mm_set1_epi32(0xff000000);
+    int passed = 0;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 zv = loadZ(z, i);
+        const __m128 incoming = Lanes::encode(format, zv);
+        const __m128 stored = Lanes::load(depths + i);
+        const __m128 pass = Lanes::passes(incoming, stored);
+        const int mask = _mm_movemask_ps(pass);
+        if (mask == 0) {
+            continue;
+        }
+        passed += __builtin_popcount(mask);
+        __m128i shaded = _mm_or_si128(alpha, _mm_slli_epi32(shadeChannel4(red, zv, coeff), 16));
+        shaded = _mm_or_si128(shaded, _mm_slli_epi32(shadeChannel4(green, zv, coeff), 8));
+        shaded = _mm_or_si128(shaded, shadeChannel4(blue, zv, coeff));
+        const __m128i passMask = _mm_castps_si128(pass);
+        const __m128i old = _mm_loadu_si128(reinterpret_cast<const __m128i*>(colors + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(colors + i),
+                         _mm_or_si128(_mm_and_si128(passMask, shaded), _mm_andnot_si128(passMask, old)));
+        Lanes::store(depths + i, _mm_or_ps(_mm_and_ps(pass, incoming), _mm_andnot_ps(pass, stored)));
+    }
+    return passed + shadeScalar(colors, depths, format, i, count, z, color, colorCoeff);
+}
+
+// The vector loops return how many pixels they shaded and leave the rest
+// to the scalar one.
+int shadeColorsSse2(QRgb* colors, int count, const float* z, QRgb color, float colorCoeff) {
+    const __m128 red = _mm_set1_ps(qRed(color));
+    const __m128 green = _mm_set1_ps(qGreen(color));
+    const __m128 blue = _mm_set1_ps(qBlue(color));
+    const __m128 coeff = _mm_set1_ps(colorCoeff);
+    const __m128i alpha = _mm_set1_epi32(0xff000000);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 zv = _mm_loadu_ps(z + i);
+        __m128i shaded = _mm_or_si128(alpha, _mm_slli_epi32(shadeChannel4(red, zv, coeff), 16));
+        shaded = _mm_or_si128(shaded, _mm_slli_epi32(shadeChannel4(green, zv, coeff), 8));
+        shaded = _mm_or_si128(shaded, shadeChannel4(blue, zv, coeff));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(colors + i), shaded);
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+inline __m256 loadZ8(LinearZ z, int i) {
+    const __m256 lanes = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    return _mm256_add_ps(_mm256_set1_ps(z.z0), _mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps(i), lanes), _mm256_set1_ps(z.dz)));
+}
+
+__attribute__((target("avx2")))
+inline __m256 loadZ8(ArrayZ z, int i) {
+    return _mm256_loadu_ps(z.z + i);
+}
+
+__attribute__((target("avx2")))
+inline __m256 loadZ8(SphereZ z, int i) {
+    const __m256 lanes = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 dx = _mm256_add_ps(_mm256_set1_ps(z.dx0), _mm256_add_ps(_mm256_set1_ps(i), lanes));
+    const __m256 q = _mm256_max_ps(_mm256_sub_ps(_mm256_set1_ps(z.rowQ), _mm256_mul_ps(dx, dx)), _mm256_setzero_ps());
+    return _mm256_sub_ps(_mm256_set1_ps(z.centerZ), _mm256_mul_ps(_mm256_set1_ps(z.depthScale), _mm256_sqrt_ps(q)));
+}
+
+__attribute__((target("avx2")))
+inline __m256i shadeChannel8(__m256 channel, __m256 z, __m256 colorCoeff) {
+    const __m256 shaded = _mm256_sub_ps(channel, _mm256_mul_ps(z, colorCoeff));
+    return _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(shaded, _mm256_setzero_ps()), _mm256_set1_ps(255.f)));
+}
+
+template<class Depth, class ZSource>
+__attribute__((target("avx2")))
+int shadeAvx2(QRgb* colors, typename Depth::Value* depths, const Depth& format, int count, ZSource z, QRgb color,
+              float colorCoeff) {
+    typedef DepthLanes<Depth> Lanes;
+    const __m256 red = _mm256_set1_ps(qRed(color));
+    const __m256 green = _mm256_set1_ps(qGreen(color));
+    const __m256 blue = _mm256_set1_ps(qBlue(color));
+    const __m256 coeff = _mm256_set1_ps(colorCoeff);
+    const __m256i alpha = _mm256_set1_epi32(0xff000000);
+    int passed = 0;
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 zv = loadZ8(z, i);
+        const __m256 incoming = Lanes::encode(format, zv);
+        const __m256 stored = Lanes::load8(depths + i);
+        const __m256 pass = Lanes::passes(incoming, stored);
+        const int mask = _mm256_movemask_ps(pass);
+        if (mask == 0) {
+            continue;
+        }
+        passed += __builtin_popcount(mask);
+        __m256i shaded = _mm256_or_si256(alpha, _mm256_slli_epi32(shadeChannel8(red, zv, coeff), 16));
+        shaded = _mm256_or_si256(shaded, _mm256_slli_epi32(shadeChannel8(green, zv, coeff), 8));
+        shaded = _mm256_or_si256(shaded, shadeChannel8(blue, zv, coeff));
+        const __m256i old = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(colors + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(colors + i),
+                            _mm256_blendv_epi8(old, shaded, _mm256_castps_si256(pass)));
+        Lanes::store(depths + i, _mm256_blendv_ps(stored, incoming, pass));
+    }
+    return passed + shadeScalar(colors, depths, format, i, count, z, color, colorCoeff);
+}
+
+__attribute__((target("avx2")))
+int shadeColorsAvx2(QRgb* colors, int count, const float* z, QRgb color, float colorCoeff) {
+    const __m256 red = _mm256_set1_ps(qRed(color));
+    const __m256 green = _mm256_set1_ps(qGreen(color));
+    const __m256 blue = _mm256_set1_ps(qBlue(color));
+    const __m256 coeff = _mm256_set1_ps(colorCoeff);
+    const __m256i alpha = _mm256_set1_epi32(0xff000000);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 zv = _mm256_loadu_ps(z + i);
+        __m256i shaded = _mm256_or_si256(alpha, _mm256_slli_epi32(shadeChannel8(red, zv, coeff), 16));
+        shaded = _mm256_or_si256(shaded, _mm256_slli_epi32(shadeChannel8(green, zv, coeff), 8));
+        shaded = _mm256_or_si256(shaded, shadeChannel8(blue, zv, coeff));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(colors + i), shaded);
+    }
+    return i;
+}
+
+#endif // SPANKERNEL_X86
+
+enum class SpanKernel { Scalar, Sse2, Avx2 };
+
+SpanKernel detectSpanKernel() {
+#ifdef SPANKERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SpanKernel::Avx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return SpanKernel::Sse2;
+    }
+#endif
+    return SpanKernel::Scalar;
+}
+
+const SpanKernel spanKernel = detectSpanKernel();
+
+template<class Depth, class ZSource>
+int shade(QRgb* colors, typename Depth::Value* depths, const Depth& format, int count, ZSource z, QRgb color,
+          float colorCoeff) {
+    switch (spanKernel) {
+#ifdef SPANKERNEL_X86
+    case SpanKernel::Avx2:
+        return shadeAvx2(colors, depths, format, count, z, color, colorCoeff);
+    case SpanKernel::Sse2:
+        return shadeSse2(colors, depths, format, count, z, color, colorCoeff);
+#endif
+    default:
+        return shadeScalar(colors, depths, format, 0, count, z, color, colorCoeff);
+    }
+}
+
+}
+
+template<class Depth>
+int shadeSpan(QRgb* colors, typename Depth::Value* depths, const Depth& format, int count, float z0, float dz,
+              QRgb color, float colorCoeff, uint8_t* ids, uint8_t objectId) {
+    if (ids != nullptr) {
+        return shadeScalar(colors, depths, format, ids, objectId, count, LinearZ{z0, dz}, color, colorCoeff);
+    }
+    return shade(colors, depths, format, count, LinearZ{z0, dz}, color, colorCoeff);
+}
+
+template<class Depth>
+int shadeSpan(QRgb* colors, typename Depth::Value* depths, const Depth& format, int count, const float* z,
+              QRgb color, float colorCoeff, uint8_t* ids, uint8_t objectId) {
+    if (ids != nullptr) {
+        return shadeScalar(colors, depths, format, ids, objectId, count, ArrayZ{z}, color, colorCoeff);
+    }
+    return shade(colors, depths, format, count, ArrayZ{z}, color, colorCoeff);
+}
+
+template<class Depth>
+int shadeSphereSpan(QRgb* colors, typename Depth::Value* depths, const Depth& format, int count, float dx0,
+                    float rowQ, float centerZ, float depthScale, QRgb color, float colorCoeff, uint8_t* ids,
+                    uint8_t objectId) {
+    const SphereZ z = {dx0, rowQ, centerZ, depthScale};
+    if (ids != nullptr) {
+        return shadeScalar(colors, depths, format, ids, objectId, count, z, color, colorCoeff);
+    }
+    return shade(colors, depths, format, count, z, color, colorCoeff);
+}
+
+#define INSTANTIATE_SPAN_KERNELS(Depth) \
+    template int shadeSpan(QRgb*, Depth::Value*, const Depth&, int, float, float, QRgb, float, uint8_t*, uint8_t); \
+    template int shadeSpan(QRgb*, Depth::Value*, const Depth&, int, const float*, QRgb, float, uint8_t*, uint8_t); \
+    template int shadeSphereSpan(QRgb*, Depth::Value*, const Depth&, int, float, float, float, float, QRgb, float, uint8_t*, \
+                                 uint8_t);
+
+INSTANTIATE_SPAN_KERNELS(FloatDepth)
+INSTANTIATE_SPAN_KERNELS(ReverseFloatDepth)
+INSTANTIATE_SPAN_KERNELS(Unorm24Depth)
+INSTANTIATE_SPAN_KERNELS(Unorm16Depth)
+
+void shadeColors(QRgb* colors, int count, const float* z, QRgb color, float colorCoeff) {
+    int shaded = 0;
+    switch (spanKernel) {
+#ifdef SPANKERNEL_X86
+    case SpanKernel::Avx2:
+        shaded = shadeColorsAvx2(colors, count, z, color, colorCoeff);
+        break;
+    case SpanKernel::Sse2:
+        shaded = shadeColorsSse2(colors, count, z, color, colorCoeff);
+        break;
+#endif
+    default:
+        break;
+    }
+    shadeColorsScalar(colors, shaded, count, z, color, colorCoeff);
+}
+
+const char* spanKernelName() {
+    switch (spanKernel) {
+    case SpanKernel::Avx2:
+        return "avx2";
+    case SpanKernel::Sse2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
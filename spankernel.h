@@ -0,0 +1,72 @@
+#ifndef SPANKERNEL_H
+#define SPANKERNEL_H
+
+#include <QRgb>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "depthformat.h"
+
+// Depth test and shading of one horizontal run of pixels. A pixel passes
+// when its stored depth is farther than the incoming z, in the depth
+// format given; it then gets color - z * colorCoeff per channel, clamped to
+// [0, 255], and the new depth.
+//
+// The run is processed 8 (AVX2) or 4 (SSE2) pixels at a time when the CPU
+// supports it, picked once at runtime. All paths do the same float math,
+// so they produce identical frames. Every function is instantiated for
+// each depth format of depthformat.h, so the test is specialized at
+// compile time.
+//
+// Returns the number of pixels that passed. When ids is given, every
+// passing pixel also gets objectId there. That is only used for picking
+// single pixels and always runs the scalar path.
+
+// z of pixel i is z0 + i * dz.
+template<class Depth>
+int shadeSpan(QRgb* colors, typename Depth::Value* depths, const Depth& format, int count, float z0, float dz,
+              QRgb color, float colorCoeff, uint8_t* ids = nullptr, uint8_t objectId = 0);
+// z of pixel i is z[i].
+template<class Depth>
+int shadeSpan(QRgb* colors, typename Depth::Value* depths, const Depth& format, int count, const float* z,
+              QRgb color, float colorCoeff, uint8_t* ids = nullptr, uint8_t objectId = 0);
+// z of pixel i is centerZ - depthScale * sqrt(rowQ - (dx0 + i)^2), the
+// front of one row of a sphere, where rowQ is radius^2 - dy^2 for the row
+// and dx0 the offset of the first pixel from the center, both in pixels.
+// depthScale is the depth of a pixel, for targets with more than one pixel
+// per unit of depth. The square roots are taken in the same vector lanes as
+// the depth test.
+template<class Depth>
+int shadeSphereSpan(QRgb* colors, typename Depth::Value* depths, const Depth& format, int count, float dx0,
+                    float rowQ, float centerZ, float depthScale, QRgb color, float colorCoeff,
+                    uint8_t* ids = nullptr, uint8_t objectId = 0);
+// Shading alone, for multisampling, which tests the depth of every sample
+// on its own: colors[i] gets color - z[i] * colorCoeff per channel, the
+// same as a passing pixel above.
+void shadeColors(QRgb* colors, int count, const float* z, QRgb color, float colorCoeff);
+// Name of the instruction set the span kernel dispatched to.
+const char* spanKernelName();
+
+inline float sphereZ(float dx, float rowQ, float centerZ, float depthScale) {
+    return centerZ - depthScale * std::sqrt(std::max(rowQ - dx * dx, 0.f));
+}
+
+inline int shadeChannel(int channel, float z, float colorCoeff) {
+    return static_cast<int>(std::min(std::max(channel - z * colorCoeff, 0.f), 255.f));
+}
+
+template<class Depth>
+inline bool shadePixel(QRgb& color, typename Depth::Value& depth, float z, QRgb baseColor, float colorCoeff,
+                       const Depth& format) {
+    const typename Depth::Value incoming = format.encode(z);
+    if (Depth::key(depth) > Depth::key(incoming)) {
+        color = qRgb(shadeChannel(qRed(baseColor), z, colorCoeff),
+                     shadeChannel(qGreen(baseColor), z, colorCoeff),
+                     shadeChannel(qBlue(baseColor), z, colorCoeff));
+        depth = incoming;
+        return true;
+    }
+    return false;
+}
+
+#endif // SPANKERNEL_H
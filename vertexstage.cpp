@@ -0,0 +1,82 @@
+#include "vertexstage.h"
+
+#include <QtGlobal>
+
+#if defined(Q_PROCESSOR_X86) && defined(__SSE2__)
+#define VERTEXSTAGE_SSE2
+#include <emmintrin.h>
+#endif
+
+static_assert(sizeof(QVector3D) == 3 * sizeof(float), "positions are read as packed float triples");
+
+void ClipVertices::resize(int count) {
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    w.resize(count);
+}
+
+namespace {
+
+// Row r of the matrix, so that a component is m[0] * x + m[1] * y + m[2] * z + m[3].
+struct MatrixRow {
+    float m[4];
+    float map(float x, float y, float z) const { return m[0] * x + m[1] * y + m[2] * z + m[3]; }
+};
+
+#ifdef VERTEXSTAGE_SSE2
+
+inline __m128 mapRow(const MatrixRow& row, __m128 x, __m128 y, __m128 z) {
+    __m128 result = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(row.m[0]), x), _mm_mul_ps(_mm_set1_ps(row.m[1]), y));
+    result = _mm_add_ps(result, _mm_mul_ps(_mm_set1_ps(row.m[2]), z));
+    return _mm_add_ps(result, _mm_set1_ps(row.m[3]));
+}
+
+// Transforms vertices [0, count rounded down to 4) and returns where it
+// stopped.
+int transformSse2(const MatrixRow (&rows)[4], const float* positions, int count, ClipVertices& out) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        // Three loads hold x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3.
+        const __m128 a = _mm_loadu_ps(positions + 3 * i);
+        const __m128 b = _mm_loadu_ps(positions + 3 * i + 4);
+        const __m128 c = _mm_loadu_ps(positions + 3 * i + 8);
+        const __m128 x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+        const __m128 y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+                                        _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+                                        _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+        _mm_storeu_ps(out.x.data() + i, mapRow(rows[0], x, y, z));
+        _mm_storeu_ps(out.y.data() + i, mapRow(rows[1], x, y, z));
+        _mm_storeu_ps(out.z.data() + i, mapRow(rows[2], x, y, z));
+        _mm_storeu_ps(out.w.data() + i, mapRow(rows[3], x, y, z));
+    }
+    return i;
+}
+
+#endif // VERTEXSTAGE_SSE2
+
+}
+
+void transformVertices(const QMatrix4x4& matrix, const std::vector<QVector3D>& positions, ClipVertices& out) {
+    const int count = static_cast<int>(positions.size());
+    out.resize(count);
+    MatrixRow rows[4];
+    for (int row = 0; row < 4; row++) {
+        for (int column = 0; column < 4; column++) {
+            rows[row].m[column] = matrix(row, column);
+        }
+    }
+    const float* packed = reinterpret_cast<const float*>(positions.data());
+    int i = 0;
+#ifdef VERTEXSTAGE_SSE2
+    i = transformSse2(rows, packed, count, out);
+#endif
+    for (; i < count; i++) {
+        const float x = packed[3 * i], y = packed[3 * i + 1], z = packed[3 * i + 2];
+        out.x[i] = rows[0].map(x, y, z);
+        out.y[i] = rows[1].map(x, y, z);
+        out.z[i] = rows[2].map(x, y, z);
+        out.w[i] = rows[3].map(x, y, z);
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef VERTEXSTAGE_H
+#define VERTEXSTAGE_H
+
+#include <QMatrix4x4>
+#include <QVector3D>
+#include <vector>
+
+// Homogeneous clip-space positions with one array per component, so the
+// transform runs over whole vector registers instead of one vertex at a
+// time.
+struct ClipVertices {
+    std::vector<float> x, y, z, w;
+
+    int size() const { return static_cast<int>(x.size()); }
+    void resize(int count);
+};
+
+// Maps every position, taken as (x, y, z, 1), through matrix into out.
+// Works on 4 vertices at a time with SSE2 where the compiler targets it;
+// the scalar path does the same float math in the same order, so both
+// give identical results.
+void transformVertices(const QMatrix4x4& matrix, const std::vector<QVector3D>& positions, ClipVertices& out);
+
+#endif // VERTEXSTAGE_H
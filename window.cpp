@@ -62,6 +62,7 @@ Window::Window()
     sizeDecBtn = new QPushButton("-");
     closenessIncBtn = new QPushButton("+");
     closenessDecBtn = new QPushButton("-");
+    statsLabel = new QLabel;
 
     sizeLayout = new QGridLayout;
     sizeLayout->addWidget(sizeIncBtn, 0, 0);
@@ -77,17 +78,70 @@ Window::Window()
     mainLayout->addLayout(sizeLayout, 1, 1);
     mainLayout->addWidget(closenessLabel, 1, 2);
     mainLayout->addLayout(closenessLayout, 1, 3);
+    mainLayout->addWidget(statsLabel, 2, 0, 1, 4);
 
     connect(sizeIncBtn, &QPushButton::clicked, this, &Window::sizeIncClicked);
     connect(sizeDecBtn, &QPushButton::clicked, this, &Window::sizeDecClicked);
     connect(closenessIncBtn, &QPushButton::clicked, this, &Window::closenessIncClicked);
     connect(closenessDecBtn, &QPushButton::clicked, this, &Window::closenessDecClicked);
+    connect(renderArea, &RenderArea::frameSubmitted, this, &Window::updateStats);
 
     setLayout(mainLayout);
 
     setWindowTitle(tr("Lab 5"));
 }
 
+void Window::setMesh(std::shared_ptr<const Mesh> mesh) {
+    renderArea->setMesh(std::move(mesh));
+}
+
+void Window::setFrameRateCap(double framesPerSecond) {
+    renderArea->setFrameRateCap(framesPerSecond);
+}
+
+void Window::setPerspective(float eyeDistance) {
+    renderArea->setPerspective(eyeDistance);
+}
+
+void Window::setDepthFormat(DepthFormat format) {
+    renderArea->setDepthFormat(format);
+}
+
+void Window::setSampleCount(int samples) {
+    renderArea->setSampleCount(samples);
+}
+
+void Window::setEdgeStyle(float width, float depthBias) {
+    renderArea->setEdgeStyle(width, depthBias);
+}
+
+void Window::setRenderScale(qreal scale) {
+    renderArea->setRenderScale(scale);
+}
+
+void Window::setFrameTimeBudget(double msecs) {
+    renderArea->setFrameTimeBudget(msecs);
+}
+
+void Window::setProfilerOverlayVisible(bool visible) {
+    renderArea->setProfilerOverlayVisible(visible);
+}
+
+void Window::startTracing() {
+    renderArea->startTracing();
+}
+
+bool Window::saveTrace(const QString &fileName, QString &errorMessage) const {
+    return renderArea->saveTrace(fileName, errorMessage);
+}
+
+void Window::updateStats() {
+    statsLabel->setText(QString("Кадров: %1, объединено событий: %2, пропущено сцен: %3")
+                        .arg(renderArea->submittedFrameCount())
+                        .arg(renderArea->mergedEventCount())
+                        .arg(renderArea->droppedSceneCount()));
+}
+
 void Window::sizeIncClicked() {
     renderArea->sizeIncClicked();
 }
@@ -111,6 +165,7 @@ Window::~Window() {
     delete sizeDecBtn;
     delete closenessIncBtn;
     delete closenessDecBtn;
+    delete statsLabel;
     delete sizeLayout;
     delete closenessLayout;
     delete renderArea;
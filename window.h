@@ -52,6 +52,10 @@
 
 #include <QWidget>
 #include <QtWidgets>
+#include <memory>
+
+class Mesh;
+enum class DepthFormat;
 
 class RenderArea;
 
@@ -62,12 +66,24 @@ class Window : public QWidget
 public:
     Window();
     ~Window() override;
+    void setMesh(std::shared_ptr<const Mesh> mesh);
+    void setFrameRateCap(double framesPerSecond);
+    void setPerspective(float eyeDistance);
+    void setDepthFormat(DepthFormat format);
+    void setSampleCount(int samples);
+    void setEdgeStyle(float width, float depthBias);
+    void setRenderScale(qreal scale);
+    void setFrameTimeBudget(double msecs);
+    void setProfilerOverlayVisible(bool visible);
+    void startTracing();
+    bool saveTrace(const QString &fileName, QString &errorMessage) const;
 
 private:
     RenderArea *renderArea;
     QGridLayout *mainLayout;
     QLabel* sizeLabel;
     QLabel* closenessLabel;
+    QLabel* statsLabel;
     QPushButton* sizeIncBtn;
     QPushButton* sizeDecBtn;
     QPushButton* closenessIncBtn;
@@ -78,4 +94,5 @@ private:
     void sizeDecClicked();
     void closenessIncClicked();
     void closenessDecClicked();
+    void updateStats();
 };